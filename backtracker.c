@@ -55,7 +55,7 @@ main(int notused, char**ignored)
   puts(board);
   free(board);
 
-  dm = findlongestpath(g, VISITED);
+  dm = findlongestpathby(g, VISITED, LONGEST_DETECT);
   if(!dm) {
     printf("Ooops, solver broke\n");
   }
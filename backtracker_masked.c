@@ -77,7 +77,7 @@ main(int notused, char**ignored)
     printf("Um, issue.\n");
   }
 
-  dm = findlongestpath(g, VISITED);
+  dm = findlongestpathby(g, VISITED, LONGEST_DETECT);
   if(!dm) {
     printf("Ooops, solver broke\n");
   }
@@ -0,0 +1,154 @@
+/* Timing comparisons for distance.c solvers.
+ *
+ * Builds the same kinds of test mazes as testdistance.c (a serpentine
+ * worst case path, and a hollow grid with no walls at all) plus a
+ * random backtracker maze, then times point to point solving between
+ * random pairs of cells with each solver. Only the solving (and path
+ * finding) is timed, not resetting the map. The "touched" column is the
+ * average number of cells with a distance in the map afterwards.
+ *
+ * Then times full (NONLAZYMAP) flood fills with distanceto(), the
+ * threaded pdistanceto(), and diroptdistanceto(). Times are wall clock.
+ *
+ * Usage: benchdistance [rows [cols [pairs]]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "mazes.h"
+
+#define SOLVE_FLOOD	0
+#define SOLVE_BIDI	1
+#define SOLVE_ASTAR	2
+#define SOLVERS		3
+
+static const char *solvername[SOLVERS] = { "distanceto lazy", "bidistanceto",
+				"astardistanceto" };
+
+/* wall clock seconds */
+double
+seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* count of cells given a distance */
+int
+touched(DMAP *dm)
+{
+  int count = 0;
+  for(int i = 0; i < dm->msize; i ++) {
+    if(dm->map[i] >= 0) { count ++; }
+  }
+  return count;
+}
+
+void
+benchgrid(GRID *g, const char *label, int pairs)
+{
+  DMAP *dm;
+  int *from, *to;
+  double start, secs;
+  long sum, seen;
+
+  from = (int *)malloc( pairs * sizeof(int) );
+  to   = (int *)malloc( pairs * sizeof(int) );
+  for(int p = 0; p < pairs; p ++) {
+    from[p] = random() % g->max;
+    to[p]   = random() % g->max;
+  }
+
+  printf("%s, %d x %d, %d pairs\n", label, g->rows, g->cols, pairs);
+  dm = createdistancemap(g, visitid(g, 0));
+  for(int s = 0; s < SOLVERS; s ++) {
+    sum = seen = 0;
+    secs = 0;
+    for(int p = 0; p < pairs; p ++) {
+      resetdistancemap(dm, visitid(g, from[p]));
+      start = seconds();
+      if(s == SOLVE_FLOOD) {
+        sum += distanceto(dm, visitid(g, to[p]), LAZYMAP);
+        findpath(dm);
+      } else if(s == SOLVE_BIDI) {
+        sum += bidistanceto(dm, visitid(g, to[p]));
+      } else {
+        sum += astardistanceto(dm, visitid(g, to[p]));
+      }
+      secs += seconds() - start;
+      seen += touched(dm);
+    }
+    printf("  %-16s %9.4f sec  distance sum %8ld  touched %9ld\n",
+		solvername[s], secs, sum, seen / pairs);
+  }
+  putchar('\n');
+
+  freedistancemap(dm);
+  free(from);
+  free(to);
+}
+
+void
+benchflood(GRID *g, const char *label)
+{
+  DMAP *dm;
+  double start;
+
+  printf("%s, %d x %d, full flood fill from center\n", label,
+		g->rows, g->cols);
+  for(int threads = 1; threads <= 8; threads *= 2) {
+    dm = createdistancemap(g, visitid(g, g->max / 2));
+    start = seconds();
+    pdistanceto(dm, visitid(g, 0), threads);
+    printf("  %d thread%s %9.4f sec  farthest %d\n", threads,
+		(threads == 1)? " ": "s", seconds() - start, dm->farthest);
+    freedistancemap(dm);
+  }
+  dm = createdistancemap(g, visitid(g, g->max / 2));
+  start = seconds();
+  diroptdistanceto(dm, visitid(g, 0), NONLAZYMAP);
+  printf("  dir. optimizing %9.4f sec  farthest %d\n", seconds() - start,
+		dm->farthest);
+  freedistancemap(dm);
+  putchar('\n');
+}
+
+int
+main(int argc, char**argv)
+{
+  GRID *g;
+  HOLLOWCONFIG hmode = { .mode = HMODE_ALL, .ctype = 1 };
+  int rows = 300, cols = 300, pairs = 50;
+
+  if(argc > 1) { rows  = atoi(argv[1]); }
+  if(argc > 2) { cols  = atoi(argv[2]); }
+  if(argc > 3) { pairs = atoi(argv[3]); }
+  if((rows < 2) || (cols < 2) || (pairs < 1)) {
+    fprintf(stderr, "Usage: benchdistance [rows [cols [pairs]]]\n");
+    return 2;
+  }
+  srandom(1);
+
+  g = creategrid(rows, cols, 1);
+  iterategrid(g, serpentine, NULL);
+  benchgrid(g, "serpentine", pairs);
+  freegrid(g);
+
+  g = creategrid(rows, cols, 1);
+  iterategrid(g, (IFUNC_P) hollow, &hmode);
+  benchgrid(g, "hollow", pairs);
+  benchflood(g, "hollow");
+  freegrid(g);
+
+  g = creategrid(rows, cols, UNVISITED);
+  seedgrid(g, 1);
+  backtracker(g, NULL);
+  benchgrid(g, "backtracker", pairs);
+  benchflood(g, "backtracker");
+  freegrid(g);
+
+  return 0;
+}
@@ -0,0 +1,123 @@
+/* Timing comparisons for grid storage.
+ *
+ * Makes, solves, and prints the same mazes twice: once with plain cells
+ * and once with the packed connectivity plane enabled (see enableplane()
+ * in grid.h). Generators pay a little to keep the plane in sync, solvers
+ * and anything else that only asks "which ways are open" can read the
+ * plane instead of the much larger cells. Times are wall clock, the
+ * rate is millions of cells generated per second. Run it on a large
+ * grid (eg 3000 3000) to compare generator throughput.
+ *
+ * Usage: benchgrid [rows [cols]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "mazes.h"
+
+#define GEN_BTREE	0
+#define GEN_ALDBRO	1
+#define GEN_WILSON	2
+#define GEN_BACKTRACK	3
+#define GEN_HUNTKILL	4
+#define GEN_SIDEWINDER	5
+#define GEN_PBTREE	6
+#define GEN_PSIDEWINDER	7
+#define GEN_KRUSKAL	8
+#define GEN_GROWING	9
+#define GEN_DIVISION	10
+#define GENERATORS	11
+
+/* threads for the row parallel generators */
+#define GEN_THREADS	4
+
+static const char *genname[GENERATORS] = { "binary tree", "aldbro",
+				"wilson", "backtracker", "huntandkill",
+				"sidewinder", "pbinarytree", "psidewinder",
+				"kruskal", "growingtree", "division" };
+
+/* wall clock seconds */
+double
+seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* makes a maze, returns seconds taken */
+double
+generate(GRID *g, int gen)
+{
+  double start = seconds();
+
+  switch(gen) {
+    case GEN_BTREE:     iterategrid(g, btreewalker, NULL); break;
+    case GEN_ALDBRO:    aldbro(g, NULL); break;
+    case GEN_WILSON:    wilson(g, NULL); break;
+    case GEN_BACKTRACK: backtracker(g, NULL); break;
+    case GEN_HUNTKILL:  huntandkill(g, NULL); break;
+    case GEN_SIDEWINDER: {
+	sw_tree_status ts = { 0 };
+	iterategrid(g, sidewinderwalker, &ts);
+      }
+      break;
+    case GEN_PBTREE:      pbinarytree(g, GEN_THREADS); break;
+    case GEN_PSIDEWINDER: psidewinder(g, GEN_THREADS); break;
+    case GEN_KRUSKAL:     kruskal(g, NULL); break;
+    case GEN_GROWING:     growingtree(g, NULL, GROW_MIXED); break;
+    case GEN_DIVISION:    recursivedivision(g, GEN_THREADS); break;
+  }
+  return seconds() - start;
+}
+
+int
+main(int argc, char**argv)
+{
+  GRID *g;
+  DMAP *dm;
+  char *board;
+  double start, gentime, solvetime, drawtime;
+  int rows = 500, cols = 500;
+
+  if(argc > 1) { rows = atoi(argv[1]); }
+  if(argc > 2) { cols = atoi(argv[2]); }
+  if((rows < 2) || (cols < 2)) {
+    fprintf(stderr, "Usage: benchgrid [rows [cols]]\n");
+    return 2;
+  }
+
+  printf("%d x %d grids, times in seconds\n", rows, cols);
+  printf("%-12s %-6s %9s %9s %9s %9s\n", "maze", "plane", "generate",
+		"Mcells/s", "solve", "ascii");
+  for(int gen = 0; gen < GENERATORS; gen ++) {
+    for(int plane = 0; plane < 2; plane ++) {
+      /* same maze both times */
+      g = creategrid(rows, cols, UNVISITED);
+      seedgrid(g, gen + 1);
+      if(plane) { enableplane(g); }
+
+      gentime = generate(g, gen);
+
+      dm = createdistancemap(g, visitid(g, 0));
+      start = seconds();
+      distanceto(dm, visitid(g, g->max - 1), NONLAZYMAP);
+      solvetime = seconds() - start;
+      freedistancemap(dm);
+
+      start = seconds();
+      board = ascii_grid(g, 0);
+      drawtime = seconds() - start;
+      free(board);
+
+      printf("%-12s %-6s %9.4f %9.2f %9.4f %9.4f\n", genname[gen],
+		plane? "yes": "no", gentime, g->max / gentime / 1e6,
+		solvetime, drawtime);
+      freegrid(g);
+    }
+  }
+
+  return 0;
+}
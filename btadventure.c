@@ -108,7 +108,7 @@ createdungeon(void)
   /* rotate takes 90, 180, and 270 as acceptable values for
    * CLOCKWISE, ROTATE_180, and COUNTERCLOCKWISE
    */
-  deg = 90 * (1 + (random() % 3));
+  deg = 90 * (1 + gridrandrange(g, 3));
   if(rotategrid(g, deg)) {
     printf("rotation failed\n");
     return(NULL);
@@ -200,7 +200,7 @@ visitnext(GRID *g, CELL *c)
 
   room = (ROOMDATA*)c->data;
 
-  if((room->visits > 5) && (random() % 3)) {
+  if((room->visits > 5) && gridrandrange(g, 3)) {
     printf("Tramping through this room yet again, you disturb an old vibration\n");
     printf("sensor. The pins holding up the concrete ceiling retract with fatal\n");
     printf("consequences.\n");
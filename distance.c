@@ -3,10 +3,49 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "grid.h"
 #include "distance.h"
 
+/* frees the TRAIL compatibility version of a path, if one was made */
+static
+void
+freetrail(DMAP *dm)
+{
+  TRAIL *walker;
+
+  walker = dm->path;
+  while(walker) {
+    TRAIL *goner = walker;
+    walker = walker->next;
+    free(goner);
+  }
+  dm->path = NULL;
+} /* freetrail() */
+
+/* the id of the neighbor in direction go if there's a passage that way,
+ * using the same rules as distanceto(), else NC
+ */
+static
+int
+openneighbor(GRID *g, CELL *c, int go)
+{
+  if(c->dir[go] == NC) { return NC; }
+  switch(go) {
+    case NORTH: if(c->row == 0)          { return NC; }
+                return c->id - g->cols;
+    case SOUTH: if(c->row == g->rows - 1) { return NC; }
+                return c->id + g->cols;
+    case WEST:  if(c->col == 0)          { return NC; }
+                return c->id - 1;
+    case EAST:  if(c->col == g->cols - 1) { return NC; }
+                return c->id + 1;
+  }
+  return NC;
+} /* openneighbor() */
+
 /* mallocs and initializes the distance map structure to
  * match a particular grid.
  */
@@ -23,6 +62,44 @@ createdistancemap(GRID *g, CELL *c)
 
   dm->grid = g;
   dm->path = NULL;
+  dm->pathids = NULL;
+  dm->pathlen = 0;
+  dm->scratch = NULL;
+  dm->openbits = NULL;
+  dm->msize = g->max;
+
+  dm->map = malloc( g->max * sizeof(int) );
+  if(!dm->map) { free(dm); return NULL; }
+
+  /* two frontier buffers, swapped every level of the flood fill */
+  dm->frontier = malloc( (g->max + 1) * sizeof(int) );
+  if(!dm->frontier) { free (dm->map); free(dm); return NULL; }
+
+  dm->nextfrontier = malloc( (g->max + 1) * sizeof(int) );
+  if(!dm->nextfrontier) {
+    free (dm->frontier); free (dm->map); free(dm);
+    return NULL;
+  }
+
+  resetdistancemap(dm, c);
+
+  return dm;
+} /* createdistancemap() */
+
+/* Re-initializes an existing distance map for a (possibly new) root
+ * cell on the same grid, keeping the map and frontier memory. Any
+ * previously found path is freed. Returns 0 on success, and
+ * DISTANCE_ERROR if the cell doesn't belong on the map's grid.
+ */
+int
+resetdistancemap(DMAP *dm, CELL *c)
+{
+  if(!dm) { return DISTANCE_ERROR; }
+  if(!c) { return DISTANCE_ERROR; }
+  if((c->id < 0) || (c->id >= dm->msize)) { return DISTANCE_ERROR; }
+
+  freetrail(dm);
+  dm->pathlen = 0;
 
   dm->root_id = c->id;
   dm->target_id = NC;
@@ -30,38 +107,28 @@ createdistancemap(GRID *g, CELL *c)
   dm->farthest = NV;
   dm->rrow = c->row;
   dm->rcol = c->col;
-  dm->msize = g->max;
 
-  dm->map = malloc( g->max * sizeof(int) );
-  if(!dm->map) { free(dm); return NULL; }
-
-  dm->frontier = malloc( g->max * sizeof(int) + 1 );
-  if(!dm->frontier) { free (dm->map); free(dm); return NULL; }
-
-  for (int m = 0; m < g->max; m++) {  dm->map[m] = NOT_VISITED; }
+  for (int m = 0; m < dm->msize; m++) {  dm->map[m] = NOT_VISITED; }
 
   dm->frontier[0] = dm->root_id;
   dm->frontier[1] = NV;
 
-  return dm;
-} /* createdistancemap() */
+  return 0;
+} /* resetdistancemap() */
 
 /* frees the various bits of a distance map */
 void
 freedistancemap(DMAP *dm)
 {
-  TRAIL *walker;
-
   if(!dm) { return; }
   if(dm->map) { free (dm->map); }
   if(dm->frontier) { free (dm->frontier); }
+  if(dm->nextfrontier) { free (dm->nextfrontier); }
+  if(dm->pathids) { free (dm->pathids); }
+  if(dm->scratch) { free (dm->scratch); }
+  if(dm->openbits) { free (dm->openbits); }
 
-  walker = dm->path;
-  while(walker) {
-    TRAIL *goner = walker;
-    walker = walker->next;
-    free(goner);
-  }
+  freetrail(dm);
 
   free(dm);
 } /* freedistancemap() */
@@ -74,13 +141,14 @@ freedistancemap(DMAP *dm)
  * This must be run (with a distance found) for findpath() to
  * work, findpath() can use lazy results, finding longest
  * possible path, findlongestpath(), needs full results.
+ * Connectivity is read from the grid's plane when it has one.
  */
 int
 distanceto(DMAP *dm, CELL *c, int lazy)
 {
   int want;
   int of, nf;
-  int *frontier;
+  int *frontier, *swap;
   CELL *fcell;
   CELL *vcell;
   int far, found;
@@ -100,10 +168,13 @@ distanceto(DMAP *dm, CELL *c, int lazy)
 
   far = found = 0;
 
-  while( far < dm->msize ) {
+  /* Each level reads dm->frontier and writes the next level into
+   * dm->nextfrontier, then the two buffers trade places. No memory
+   * is allocated here, so repeated calls on a map are cheap.
+   */
+  while( (far < dm->msize) && (dm->frontier[0] != NV) ) {
 
-    frontier = malloc( dm->msize * sizeof(int) + 1 );
-    if(!frontier) { return DISTANCE_ERROR; }
+    frontier = dm->nextfrontier;
     nf = 0;
     frontier[0] = NV;
 
@@ -117,16 +188,10 @@ distanceto(DMAP *dm, CELL *c, int lazy)
 	}
       }
 
-      fcell = visitid(dm->grid, dm->frontier[of]);
-      if(!fcell) {
-	free(frontier);
-	return DISTANCE_ERROR;
-      }
-
-      if(fcell->id == want) {
+      if(dm->frontier[of] == want) {
         dm->target_id = want;
 	if(lazy) {
-	  free(dm->frontier);
+	  dm->nextfrontier = dm->frontier;
 	  dm->frontier = frontier;
 	  return far;
 	} else {
@@ -134,15 +199,45 @@ distanceto(DMAP *dm, CELL *c, int lazy)
 	}
       }
 
+      if(dm->grid->plane) {
+	/* packed connectivity: no need to touch the cells at all */
+	int id = dm->frontier[of];
+	int cols = dm->grid->cols;
+	int bits = planebits(dm->grid, id);
+
+	if(id < cols)                   { bits &= ~(1 << NORTH); }
+	if(id >= dm->msize - cols)      { bits &= ~(1 << SOUTH); }
+	if(id % cols == 0)              { bits &= ~(1 << WEST); }
+	if(id % cols == cols - 1)       { bits &= ~(1 << EAST); }
+
+	for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+	  int vid;
+	  if(!(bits & (1 << go))) { continue; }
+	  if(go == NORTH) { vid = id - cols; }
+	  if(go == SOUTH) { vid = id + cols; }
+	  if(go == WEST ) { vid = id - 1; }
+	  if(go == EAST ) { vid = id + 1; }
+	  if(dm->map[vid] == NOT_VISITED) {
+	    frontier[nf++] = vid;
+	    dm->map[vid] = FRONTIER;
+	  }
+	}
+	frontier[nf] = NV;
+	continue;
+      }
+
+      fcell = visitid(dm->grid, dm->frontier[of]);
+      if(!fcell) {
+	return DISTANCE_ERROR;
+      }
+
       edges = edgestatusbycell(dm->grid, fcell);
       if(edges == EDGE_ERROR) {
-	free(frontier);
 	return DISTANCE_ERROR;
       }
 
       walls = wallstatusbycell(fcell);
       if(walls == WALL_ERROR) {
-	free(frontier);
 	return DISTANCE_ERROR;
       }
       
@@ -157,7 +252,6 @@ distanceto(DMAP *dm, CELL *c, int lazy)
 	if(! check) {
 	  vcell = visitdir(dm->grid, fcell, go, ANY);
 	  if(! vcell ) {
-	    free(frontier);
 	    return DISTANCE_ERROR;
 	  }
 
@@ -175,8 +269,9 @@ distanceto(DMAP *dm, CELL *c, int lazy)
 
     } /* for id in frontier */
     far ++;
-    free(dm->frontier);
+    swap = dm->frontier;
     dm->frontier = frontier;
+    dm->nextfrontier = swap;
 
     // printf("\nDebug round %d\n", far);
     // ascii_dmap(dm);
@@ -189,12 +284,718 @@ distanceto(DMAP *dm, CELL *c, int lazy)
   return(DISTANCE_ERROR);
 } /* distanceto() */
 
+/* Shared state for the pdistanceto() worker threads. */
+typedef struct {
+  DMAP *dm;
+  int threads;
+  int fsize;		/* cells in dm->frontier this level */
+  int far;		/* distance of this level */
+  int *counts;		/* cells each thread claimed for next level */
+  int ready;		/* 1 once threads is final and barrier made, -1 to quit */
+  pthread_mutex_t lock;
+  pthread_cond_t go;
+  pthread_barrier_t barrier;
+} PFILL;
+
+typedef struct {
+  PFILL *pf;
+  int tid;
+} PWORKER;
+
+/* A thread claims cell nid for the next level by storing a negative
+ * key made from the frontier position and direction it was reached
+ * from. The lowest position and direction wins, which is the cell
+ * that would have found it first in the serial distanceto(), so the
+ * next frontier comes out in the same order.
+ */
+#define CLAIMKEY(pos,go)	( -4 - ((pos) * FOURDIRECTIONS + (go)) )
+
+/* Levels with fewer than this many cells per thread are done by the
+ * first thread alone, while the others sleep. Perfect mazes mostly
+ * have tiny frontiers and would spend all their time at barriers.
+ */
+#define PFILL_SERIAL	256
+
+/* finish a level: next frontier becomes the frontier */
+static
+void
+pfillswap(PFILL *pf, int count)
+{
+  DMAP *dm = pf->dm;
+  int *swap;
+
+  dm->nextfrontier[count] = NV;
+  if(count) {
+    dm->farthest = pf->far + 1;
+    dm->farthest_id = dm->nextfrontier[0];
+  }
+  swap = dm->frontier;
+  dm->frontier = dm->nextfrontier;
+  dm->nextfrontier = swap;
+  pf->fsize = count;
+  pf->far ++;
+} /* pfillswap() */
+
+static
+void *
+pfillworker(void *arg)
+{
+  PWORKER *pw = (PWORKER *)arg;
+  PFILL *pf = pw->pf;
+  DMAP *dm = pf->dm;
+  GRID *g = dm->grid;
+  int lo, hi, nid, key, cur, count, off;
+
+  /* wait for the thread count to be settled */
+  pthread_mutex_lock(&pf->lock);
+  while(!pf->ready) {
+    pthread_cond_wait(&pf->go, &pf->lock);
+  }
+  pthread_mutex_unlock(&pf->lock);
+  if(pf->ready < 0) { return NULL; }
+
+  for(;;) {
+    if(pw->tid == 0) {
+      while(pf->fsize && (pf->fsize < PFILL_SERIAL * pf->threads)) {
+	count = 0;
+	for(int i = 0; i < pf->fsize; i ++) {
+	  CELL *fcell = quickvisitid(g, dm->frontier[i]);
+	  for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+	    nid = openneighbor(g, fcell, go);
+	    if((nid != NC) && (dm->map[nid] == NV)) {
+	      dm->map[nid] = pf->far + 1;
+	      dm->nextfrontier[count++] = nid;
+	    }
+	  }
+	}
+	pfillswap(pf, count);
+      }
+    }
+    pthread_barrier_wait(&pf->barrier);
+    if(!pf->fsize) { break; }
+
+    lo = (int)((long)pf->fsize * pw->tid / pf->threads);
+    hi = (int)((long)pf->fsize * (pw->tid + 1) / pf->threads);
+
+    /* claim */
+    for(int i = lo; i < hi; i ++) {
+      CELL *fcell = quickvisitid(g, dm->frontier[i]);
+      for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+	nid = openneighbor(g, fcell, go);
+	if(nid == NC) { continue; }
+	key = CLAIMKEY(i, go);
+	cur = __atomic_load_n(&dm->map[nid], __ATOMIC_RELAXED);
+	while( (cur == NV) || ((cur < FRONTIER) && (cur < key)) ) {
+	  if(__atomic_compare_exchange_n(&dm->map[nid], &cur, key, 0,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	    break;
+	  }
+	}
+      }
+    }
+    pthread_barrier_wait(&pf->barrier);
+
+    /* count what was won */
+    count = 0;
+    for(int i = lo; i < hi; i ++) {
+      CELL *fcell = quickvisitid(g, dm->frontier[i]);
+      for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+	nid = openneighbor(g, fcell, go);
+	if((nid != NC) && (dm->map[nid] == CLAIMKEY(i, go))) { count ++; }
+      }
+    }
+    pf->counts[pw->tid] = count;
+    pthread_barrier_wait(&pf->barrier);
+
+    /* write into place, in frontier order */
+    off = 0;
+    for(int t = 0; t < pw->tid; t ++) { off += pf->counts[t]; }
+    for(int i = lo; i < hi; i ++) {
+      CELL *fcell = quickvisitid(g, dm->frontier[i]);
+      for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+	nid = openneighbor(g, fcell, go);
+	if((nid != NC) &&
+	   (__atomic_load_n(&dm->map[nid], __ATOMIC_RELAXED) == CLAIMKEY(i, go))) {
+	  dm->nextfrontier[off++] = nid;
+	  __atomic_store_n(&dm->map[nid], pf->far + 1, __ATOMIC_RELAXED);
+	}
+      }
+    }
+    pthread_barrier_wait(&pf->barrier);
+
+    /* the others wait at the top barrier while this is done */
+    if(pw->tid == 0) {
+      count = 0;
+      for(int t = 0; t < pf->threads; t ++) { count += pf->counts[t]; }
+      pfillswap(pf, count);
+    }
+  }
+
+  return NULL;
+} /* pfillworker() */
+#undef CLAIMKEY
+
+/* A multithreaded NONLAZYMAP distanceto(), for very large grids. Each
+ * level of the flood fill is split between threads, which claim cells
+ * for the next level with atomic compare and swap on the map. The map,
+ * farthest, farthest_id and target_id come out identical to the serial
+ * version. Fewer than two threads just runs distanceto(), and if not
+ * all threads can be started the work is split among those that did.
+ * Maps too big for the claim keys, or a failed barrier, also fall back
+ * to distanceto().
+ * Returns 0 if the target was reached, DISTANCE_ERROR otherwise.
+ */
+int
+pdistanceto(DMAP *dm, CELL *c, int threads)
+{
+  PFILL pf;
+  PWORKER *pw;
+  pthread_t *tids;
+  int started;
+
+  if(threads < 2) { return distanceto(dm, c, NONLAZYMAP); }
+  if(!dm) { return DISTANCE_ERROR; }
+  if(!c) { return DISTANCE_ERROR; }
+  if((c->id < 0) || (c->id >= dm->msize)) { return DISTANCE_ERROR; }
+  if((long)dm->msize * FOURDIRECTIONS > 0x7ffffff0L) {
+    return distanceto(dm, c, NONLAZYMAP);
+  }
+
+  pf.dm = dm;
+  pf.threads = threads;
+  pf.far = 0;
+  for(pf.fsize = 0; dm->frontier[pf.fsize] != NV; pf.fsize ++) {
+    dm->map[dm->frontier[pf.fsize]] = 0;
+  }
+  if(pf.fsize) {
+    dm->farthest = 0;
+    dm->farthest_id = dm->frontier[0];
+  }
+
+  pf.counts = (int *)malloc( threads * sizeof(int) );
+  pw = (PWORKER *)malloc( threads * sizeof(PWORKER) );
+  tids = (pthread_t *)malloc( threads * sizeof(pthread_t) );
+  if(!pf.counts || !pw || !tids) {
+    free(pf.counts);
+    free(pw);
+    free(tids);
+    return DISTANCE_ERROR;
+  }
+  pf.ready = 0;
+  pthread_mutex_init(&pf.lock, NULL);
+  pthread_cond_init(&pf.go, NULL);
+
+  for(started = 0; started < threads; started ++) {
+    pw[started].pf = &pf;
+    pw[started].tid = started;
+  }
+  for(started = 1; started < threads; started ++) {
+    if(pthread_create(&tids[started], NULL, pfillworker, &pw[started])) {
+      break;
+    }
+  }
+
+  /* the workers wait here until the barrier matches who is running */
+  pthread_mutex_lock(&pf.lock);
+  pf.threads = started;
+  if(pthread_barrier_init(&pf.barrier, NULL, started)) {
+    pf.ready = -1;
+  } else {
+    pf.ready = 1;
+  }
+  pthread_cond_broadcast(&pf.go);
+  pthread_mutex_unlock(&pf.lock);
+
+  if(pf.ready > 0) {
+    pfillworker(&pw[0]);
+  }
+  for(int t = 1; t < started; t ++) {
+    pthread_join(tids[t], NULL);
+  }
+
+  if(pf.ready > 0) {
+    pthread_barrier_destroy(&pf.barrier);
+  }
+  pthread_cond_destroy(&pf.go);
+  pthread_mutex_destroy(&pf.lock);
+  free(pf.counts);
+  free(pw);
+  free(tids);
+
+  if(pf.ready < 0) {
+    return distanceto(dm, c, NONLAZYMAP);
+  }
+  if(dm->map[c->id] >= 0) {
+    dm->target_id = c->id;
+    return 0;
+  }
+  return DISTANCE_ERROR;
+} /* pdistanceto() */
+
+/* Levels are expanded bottom up once the frontier holds more than one
+ * in DIROPT_ALPHA of the cells, and top down again once it shrinks
+ * below one in DIROPT_BETA of all cells.
+ */
+#define DIROPT_ALPHA	14
+#define DIROPT_BETA	24
+
+/* Fills in dm->openbits: one bit per direction with a passage, using
+ * the same rules as distanceto(). Bit numbers are the direction numbers.
+ * Uses the grid's connectivity plane if it has one.
+ */
+static
+int
+makeopenbits(DMAP *dm)
+{
+  GRID *g = dm->grid;
+
+  if(!dm->openbits) {
+    dm->openbits = (unsigned char *)malloc( dm->msize );
+    if(!dm->openbits) { return DISTANCE_ERROR; }
+  }
+  if(g->plane) {
+    int id = 0;
+    for(int i = 0; i < g->rows; i ++) {
+      /* no passages off the edge of the grid */
+      unsigned char mask = 0xf;
+      if(i == 0)           { mask &= ~(1 << NORTH); }
+      if(i == g->rows - 1) { mask &= ~(1 << SOUTH); }
+      for(int j = 0; j < g->cols; j ++, id ++) {
+	unsigned char bits = planebits(g, id) & mask;
+	if(j == 0)           { bits &= ~(1 << WEST); }
+	if(j == g->cols - 1) { bits &= ~(1 << EAST); }
+	dm->openbits[id] = bits;
+      }
+    }
+    return 0;
+  }
+  for(int id = 0; id < dm->msize; id ++) {
+    unsigned char bits = 0;
+    for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+      if(openneighbor(g, quickvisitid(g, id), go) != NC) { bits |= 1 << go; }
+    }
+    dm->openbits[id] = bits;
+  }
+  return 0;
+} /* makeopenbits() */
+
+/* A distanceto() that switches between the usual top down expansion
+ * (each frontier cell looks at its neighbors) and bottom up sweeps (each
+ * unvisited cell looks for a neighbor in the frontier) depending on how
+ * big the frontier is. On wide open grids the late levels are much
+ * cheaper bottom up. Connectivity comes from a packed bit per direction
+ * per cell built at the start of the call (from the grid's connectivity
+ * plane when it has one).
+ *
+ * The map and farthest come out the same as distanceto(), but when
+ * several cells are equally far, farthest_id may be a different one of
+ * them. Same returns as distanceto().
+ */
+int
+diroptdistanceto(DMAP *dm, CELL *c, int lazy)
+{
+  unsigned char *open;
+  int *next, *swap;
+  int want, far, nf, cnt, unvisited, bottomup;
+  int rows, cols, step[FOURDIRECTIONS];
+
+  if(!dm) { return DISTANCE_ERROR; }
+  if(!c) { return DISTANCE_ERROR; }
+
+  want = c->id;
+  if((want < 0) || (want >= dm->msize)) { return DISTANCE_ERROR; }
+
+  /* the trivial case */
+  if(lazy && (dm->root_id == want)) {
+    dm->map[want] = 0;
+    dm->target_id = want;
+    return 0;
+  }
+
+  if(makeopenbits(dm)) { return DISTANCE_ERROR; }
+  open = dm->openbits;
+  rows = dm->grid->rows;
+  cols = dm->grid->cols;
+  step[NORTH] = -cols;
+  step[WEST]  = -1;
+  step[EAST]  = 1;
+  step[SOUTH] = cols;
+
+  for(nf = 0; dm->frontier[nf] != NV; nf ++) {
+    dm->map[dm->frontier[nf]] = 0;
+  }
+  if(nf && !lazy) {
+    dm->farthest = 0;
+    dm->farthest_id = dm->frontier[0];
+  }
+  unvisited = dm->msize - nf;
+  far = 0;
+  bottomup = 0;
+
+  while(nf) {
+    if(!bottomup && (nf * DIROPT_ALPHA > unvisited)) {
+      bottomup = 1;
+    } else if(bottomup && (nf * DIROPT_BETA < dm->msize)) {
+      bottomup = 0;
+    }
+
+    next = dm->nextfrontier;
+    cnt = 0;
+    if(!bottomup) {
+      for(int i = 0; i < nf; i ++) {
+	int id = dm->frontier[i];
+	for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+	  if((open[id] & (1 << go)) && (dm->map[id + step[go]] == NV)) {
+	    dm->map[id + step[go]] = far + 1;
+	    next[cnt++] = id + step[go];
+	  }
+	}
+      }
+    } else {
+      /* an unvisited cell joins the next level if a neighbor on this
+       * level has a passage back to it
+       */
+      int id = 0;
+      for(int i = 0; i < rows; i ++) {
+	for(int j = 0; j < cols; j ++, id ++) {
+	  if(dm->map[id] != NV) { continue; }
+	  if(( (i > 0)        && (open[id - cols] & (1 << SOUTH))
+				&& (dm->map[id - cols] == far) ) ||
+	     ( (j > 0)        && (open[id - 1]    & (1 << EAST))
+				&& (dm->map[id - 1]    == far) ) ||
+	     ( (j < cols - 1) && (open[id + 1]    & (1 << WEST))
+				&& (dm->map[id + 1]    == far) ) ||
+	     ( (i < rows - 1) && (open[id + cols] & (1 << NORTH))
+				&& (dm->map[id + cols] == far) )) {
+	    dm->map[id] = far + 1;
+	    next[cnt++] = id;
+	  }
+	}
+      }
+    }
+    next[cnt] = NV;
+
+    far ++;
+    swap = dm->frontier;
+    dm->frontier = next;
+    dm->nextfrontier = swap;
+    nf = cnt;
+    unvisited -= cnt;
+
+    if(cnt && !lazy) {
+      dm->farthest = far;
+      dm->farthest_id = next[0];
+    }
+    if(lazy && (dm->map[want] >= 0)) {
+      dm->target_id = want;
+      return dm->map[want];
+    }
+  }
+
+  if(dm->map[want] >= 0) {
+    dm->target_id = want;
+    return 0;
+  }
+  return DISTANCE_ERROR;
+} /* diroptdistanceto() */
+
+/* Allocates the point to point solvers' per cell work space on first
+ * use. It is kept all NV between calls.
+ */
+static
+int
+needscratch(DMAP *dm)
+{
+  if(dm->scratch) { return 0; }
+
+  dm->scratch = (int *)malloc( dm->msize * sizeof(int) );
+  if(!dm->scratch) { return DISTANCE_ERROR; }
+  for(int i = 0; i < dm->msize; i ++) {
+    dm->scratch[i] = NV;
+  }
+  return 0;
+} /* needscratch() */
+
+/* Common start for the point to point solvers: checks arguments and
+ * handles the trivial root == target case. Returns 1 if that case
+ * was handled, 0 to keep solving, DISTANCE_ERROR on error.
+ */
+static
+int
+pointtopointstart(DMAP *dm, CELL *c)
+{
+  if(!dm) { return DISTANCE_ERROR; }
+  if(!c) { return DISTANCE_ERROR; }
+  if((c->id < 0) || (c->id >= dm->msize)) { return DISTANCE_ERROR; }
+  if(dm->map[dm->root_id] != NV) { return DISTANCE_ERROR; }
+  if(needscratch(dm)) { return DISTANCE_ERROR; }
+
+  dm->map[dm->root_id] = 0;
+  if(c->id == dm->root_id) {
+    dm->target_id = c->id;
+    dm->frontier[0] = NV;
+    return (findpath(dm) == 0)? 1: DISTANCE_ERROR;
+  }
+  return 0;
+} /* pointtopointstart() */
+
+/* Point to point solver: a breadth first search from both the root and
+ * the target at once, always growing the side with the smaller frontier
+ * by one full level. Every passage looked at that joins the two searches
+ * is a possible path; once the best of those is no longer than the total
+ * levels grown on both sides, nothing shorter can exist. Usually visits
+ * far fewer cells than a lazy distanceto().
+ *
+ * Only the cells reached from the root, and those on the path, have
+ * distances in the map afterwards. Passages are assumed to go both ways.
+ * The path is found (as for findpath()). On a freshly created or reset
+ * map returns the distance, or DISTANCE_NOPATH if the target can't be
+ * reached, or DISTANCE_ERROR.
+ */
+int
+bidistanceto(DMAP *dm, CELL *c)
+{
+  int *fq, *bq, *back;
+  int fh, ft, bh, bt;
+  int rc, id, nid, end, best, meetf, meetb;
+  int lf, lb;
+  GRID *g;
+
+  rc = pointtopointstart(dm, c);
+  if(rc) { return (rc == 1)? 0: rc; }
+
+  g = dm->grid;
+  back = dm->scratch;
+
+  /* the two frontier buffers become first in, first out queues */
+  fq = dm->frontier;
+  bq = dm->nextfrontier;
+  fh = bh = 0;
+  ft = bt = 0;
+  fq[ft++] = dm->root_id;
+  bq[bt++] = c->id;
+  back[c->id] = 0;
+
+  best = NV;
+  meetf = meetb = NC;
+  lf = lb = 0;	/* levels fully grown on each side */
+
+  while((fh < ft) && (bh < bt)) {
+    if((best != NV) && (best <= lf + lb)) { break; }
+
+    if((ft - fh) <= (bt - bh)) {
+      /* one level outward from the root */
+      for(end = ft; fh < end; fh ++) {
+	id = fq[fh];
+	for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+	  nid = openneighbor(g, quickvisitid(g, id), go);
+	  if(nid == NC) { continue; }
+	  if(dm->map[nid] == NV) {
+	    dm->map[nid] = dm->map[id] + 1;
+	    fq[ft++] = nid;
+	  }
+	  if((back[nid] != NV) &&
+	     ((best == NV) || (dm->map[id] + 1 + back[nid] < best))) {
+	    best = dm->map[id] + 1 + back[nid];
+	    meetf = id;
+	    meetb = nid;
+	  }
+	}
+      }
+      lf ++;
+    } else {
+      /* one level inward from the target */
+      for(end = bt; bh < end; bh ++) {
+	id = bq[bh];
+	for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+	  nid = openneighbor(g, quickvisitid(g, id), go);
+	  if(nid == NC) { continue; }
+	  if(back[nid] == NV) {
+	    back[nid] = back[id] + 1;
+	    bq[bt++] = nid;
+	  }
+	  if((dm->map[nid] != NV) &&
+	     ((best == NV) || (dm->map[nid] + 1 + back[id] < best))) {
+	    best = dm->map[nid] + 1 + back[id];
+	    meetf = nid;
+	    meetb = id;
+	  }
+	}
+      }
+      lb ++;
+    }
+  }
+
+  if(best != NV) {
+    /* give the target side of the path its distances from the root */
+    id = meetb;
+    dm->map[id] = dm->map[meetf] + 1;
+    while(id != c->id) {
+      for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+	nid = openneighbor(g, quickvisitid(g, id), go);
+	if((nid != NC) && (back[nid] == back[id] - 1)) {
+	  dm->map[nid] = dm->map[id] + 1;
+	  break;
+	}
+	nid = NC;
+      }
+      if(nid == NC) {
+	/* a one way passage: no way back to the target */
+	best = DISTANCE_ERROR;
+	break;
+      }
+      id = nid;
+    }
+  }
+
+  /* leave the scratch space clean for next time */
+  for(int i = 0; i < bt; i ++) {
+    back[bq[i]] = NV;
+  }
+  dm->frontier[0] = NV;
+  dm->nextfrontier[0] = NV;
+
+  if(best == NV) { return DISTANCE_NOPATH; }
+  if(best == DISTANCE_ERROR) { return DISTANCE_ERROR; }
+
+  dm->target_id = c->id;
+  if(findpath(dm) == DISTANCE_ERROR) { return DISTANCE_ERROR; }
+  return best;
+} /* bidistanceto() */
+
+/* Manhattan distance between two cells, never more than the real
+ * distance through the maze.
+ */
+static
+int
+manhattan(GRID *g, int id1, int id2)
+{
+  int dr, dc;
+  dr = (id1 / g->cols) - (id2 / g->cols);
+  dc = (id1 % g->cols) - (id2 % g->cols);
+  return ((dr < 0)? -dr: dr) + ((dc < 0)? -dc: dc);
+} /* manhattan() */
+
+/* A* heap ordering: lowest distance + estimate first, deepest first
+ * among equals.
+ */
+#define ASTAR_BEFORE(a,b) \
+	( (dm->map[a] + manhattan(g, a, want) < \
+	   dm->map[b] + manhattan(g, b, want)) || \
+	  ((dm->map[a] + manhattan(g, a, want) == \
+	    dm->map[b] + manhattan(g, b, want)) && \
+	   (dm->map[a] > dm->map[b])) )
+
+/* Point to point solver: A* search, expanding cells in order of distance
+ * so far plus the Manhattan distance still to go, using CELL row / col.
+ * The open cells are kept in a binary heap built in the frontier buffer.
+ *
+ * Only the cells expanded (and so with final distances) keep their
+ * distances in the map. The path is found (as for findpath()). On a
+ * freshly created or reset map returns the distance, or DISTANCE_NOPATH
+ * if the target can't be reached, or DISTANCE_ERROR.
+ */
+int
+astardistanceto(DMAP *dm, CELL *c)
+{
+  int *heap, *done, *pos;
+  int hn, dn, rc, id, nid, want, i, kid, found;
+  GRID *g;
+
+  rc = pointtopointstart(dm, c);
+  if(rc) { return (rc == 1)? 0: rc; }
+
+  g = dm->grid;
+  want = c->id;
+  heap = dm->frontier;		/* open cells */
+  done = dm->nextfrontier;	/* expanded cells, to clean up after */
+  pos = dm->scratch;		/* heap position, FRONTIER when done */
+  hn = dn = 0;
+  found = 0;
+
+  heap[hn] = dm->root_id;
+  pos[dm->root_id] = hn ++;
+
+  while(hn) {
+    id = heap[0];
+    pos[id] = FRONTIER;
+    done[dn++] = id;
+    if(id == want) {
+      found = 1;
+      break;
+    }
+
+    /* pop: move the last entry down from the top */
+    hn --;
+    if(hn) {
+      nid = heap[hn];
+      i = 0;
+      while((kid = 2 * i + 1) < hn) {
+	if((kid + 1 < hn) && ASTAR_BEFORE(heap[kid + 1], heap[kid])) { kid ++; }
+	if(!ASTAR_BEFORE(heap[kid], nid)) { break; }
+	heap[i] = heap[kid];
+	pos[heap[i]] = i;
+	i = kid;
+      }
+      heap[i] = nid;
+      pos[nid] = i;
+    }
+
+    for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+      nid = openneighbor(g, quickvisitid(g, id), go);
+      if(nid == NC) { continue; }
+      if(pos[nid] == FRONTIER) { continue; }
+
+      if(pos[nid] == NV) {
+	/* new open cell at the bottom of the heap */
+	pos[nid] = hn;
+	heap[hn ++] = nid;
+      } else if(dm->map[nid] <= dm->map[id] + 1) {
+	continue;
+      }
+      dm->map[nid] = dm->map[id] + 1;
+
+      /* sift up */
+      i = pos[nid];
+      while(i && ASTAR_BEFORE(nid, heap[(i - 1) / 2])) {
+	heap[i] = heap[(i - 1) / 2];
+	pos[heap[i]] = i;
+	i = (i - 1) / 2;
+      }
+      heap[i] = nid;
+      pos[nid] = i;
+    }
+  }
+
+  /* open cells only have estimates, drop those and clean up */
+  for(i = found; i < hn; i ++) {
+    dm->map[heap[i]] = NV;
+    pos[heap[i]] = NV;
+  }
+  for(i = 0; i < dn; i ++) {
+    pos[done[i]] = NV;
+  }
+  dm->frontier[0] = NV;
+  dm->nextfrontier[0] = NV;
+
+  if(!found) { return DISTANCE_NOPATH; }
+
+  dm->target_id = want;
+  if(findpath(dm) == DISTANCE_ERROR) { return DISTANCE_ERROR; }
+  return dm->map[want];
+} /* astardistanceto() */
+#undef ASTAR_BEFORE
+
+/* Works backwards from the target along decreasing distances to fill
+ * in pathids[] with the cell ids of a shortest path, root first.
+ * The array is reused (and resized) if findpath() is called again.
+ * Returns 0 on success, DISTANCE_ERROR otherwise.
+ */
 int
 findpath(DMAP *dm)
 {
-  TRAIL *walk;
-  TRAIL *step;
-  int id, sid, curdis;
+  int *ids;
+  int id, sid, curdis, len;
   int si, sj;
 
   if(!dm) { return DISTANCE_ERROR; }
@@ -202,22 +1003,22 @@ findpath(DMAP *dm)
   /* this is the case when distanceto() wasn't run, or failed. */
   if(dm->target_id < 0) { return DISTANCE_ERROR; }
 
-  walk = (TRAIL *)malloc( sizeof(TRAIL) );
-  if(!walk) { return DISTANCE_ERROR; }
-  
-  walk->cell_id = id = dm->target_id;
-  walk->next = NULL;
-  walk->prev = NULL;
+  curdis = dm->map[dm->target_id];
+  if(curdis < 0) { return DISTANCE_ERROR; }
 
-  while( (curdis = dm->map[id]) ) {
-    step = (TRAIL *)malloc( sizeof(TRAIL) );
-    /* this leaks memory, but only when malloc fails */
-    if(!step) { return DISTANCE_ERROR; }
-     
-    step->next = walk;
-    step->prev = NULL;
-    walk = step;
+  /* any old path (and compatibility trail) is now stale */
+  freetrail(dm);
+  dm->pathlen = 0;
 
+  len = curdis + 1;
+  ids = (int *)realloc( dm->pathids, len * sizeof(int) );
+  if(!ids) { return DISTANCE_ERROR; }
+  dm->pathids = ids;
+
+  id = dm->target_id;
+  ids[curdis] = id;
+
+  while( curdis ) {
     /* At least one neighbor should be curdis - 1,
      * but there might be multiple equally short paths.
      */
@@ -227,7 +1028,8 @@ findpath(DMAP *dm)
 #define TEST_SID \
 	if(curdis == dm->map[sid] + 1) { \
 	  if(isconnectedbyid(dm->grid, id, sid, ANYDIR) != NC) { \
-	    walk->cell_id = id = sid; \
+	    curdis --; \
+	    ids[curdis] = id = sid; \
 	    continue; \
 	  } \
 	}
@@ -250,18 +1052,115 @@ findpath(DMAP *dm)
     }
 
     /* this shouldn't be reached */
-    walk->cell_id = id = NV;
-    break;
-  }
-
-  dm->path = walk;
-  if(curdis || id == NV) {
     return DISTANCE_ERROR;
   }
 
+  dm->pathlen = len;
   return 0;
 } /* findpath() */
 
+/* The tree version of findlongestpath(). One breadth first walk from
+ * pa records each cell's parent and depth (in the map), then a single
+ * pass back up that walk order tracks the deepest leaf under every cell;
+ * the two deepest branches meeting at a cell give the longest path
+ * through it. Distances from one end of the longest path are then
+ * worked out from the depths alone, without another walk of the grid.
+ * Uses one scratch buffer. Returns NULL if a loop is found.
+ */
+static
+DMAP *
+longesttree(GRID *g, CELL *pa)
+{
+  DMAP *dm;
+  int *scratch, *order, *parent, *aux;
+  int n, k, head, id, nid, p;
+  int best, enda, endb, depa;
+
+  dm = createdistancemap(g, pa);
+  if(!dm) { return NULL; }
+
+  n = g->max;
+  scratch = (int *)malloc( 3 * n * sizeof(int) );
+  if(!scratch) {
+    freedistancemap(dm);
+    return NULL;
+  }
+  order  = scratch;
+  parent = scratch + n;
+  aux    = scratch + 2 * n;
+
+  /* walk the tree, depth of each cell goes in the map */
+  k = 0;
+  order[k++] = pa->id;
+  parent[pa->id] = NC;
+  dm->map[pa->id] = 0;
+  for(head = 0; head < k; head ++) {
+    id = order[head];
+    aux[id] = id;	/* deepest leaf below id, so far */
+    for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+      nid = openneighbor(g, quickvisitid(g, id), go);
+      if((nid == NC) || (nid == parent[id])) { continue; }
+      if(dm->map[nid] != NV) {
+	/* reached a second way: has a loop */
+	free(scratch);
+	freedistancemap(dm);
+	return NULL;
+      }
+      dm->map[nid] = dm->map[id] + 1;
+      parent[nid] = id;
+      order[k++] = nid;
+    }
+  }
+
+  /* leaves up: join each branch to its parent's deepest branch so far */
+  best = 0;
+  enda = endb = pa->id;
+  for(head = k - 1; head > 0; head --) {
+    id = order[head];
+    p = parent[id];
+    if(dm->map[aux[id]] + dm->map[aux[p]] - 2 * dm->map[p] > best) {
+      best = dm->map[aux[id]] + dm->map[aux[p]] - 2 * dm->map[p];
+      enda = aux[p];
+      endb = aux[id];
+    }
+    if(dm->map[aux[id]] > dm->map[aux[p]]) {
+      aux[p] = aux[id];
+    }
+  }
+
+  /* mark ancestors of enda, then every cell gets its nearest one */
+  for(head = 0; head < k; head ++) { aux[order[head]] = NC; }
+  for(id = enda; id != NC; id = parent[id]) { aux[id] = id; }
+  for(head = 1; head < k; head ++) {
+    id = order[head];
+    if(aux[id] == NC) { aux[id] = aux[parent[id]]; }
+  }
+
+  /* convert depths to distances from enda, children before parents
+   * so ancestor depths are still there to read
+   */
+  depa = dm->map[enda];
+  for(head = k - 1; head >= 0; head --) {
+    id = order[head];
+    dm->map[id] = dm->map[id] + depa - 2 * dm->map[aux[id]];
+  }
+  free(scratch);
+
+  dm->root_id = enda;
+  dm->rrow = enda / g->cols;
+  dm->rcol = enda % g->cols;
+  dm->target_id = endb;
+  dm->farthest_id = endb;
+  dm->farthest = best;
+  dm->frontier[0] = NV;
+
+  if(findpath(dm) == DISTANCE_ERROR) {
+    freedistancemap(dm);
+    return NULL;
+  }
+  return dm;
+} /* longesttree() */
+
 /* Finds the longest path possible in a maze (or a longest, if there
  * are ties). Since on some grids some cells are not part of a maze,
  * eg a mask is used, a cell type to start the hunt from is needed.
@@ -272,6 +1171,18 @@ findpath(DMAP *dm)
  */
 DMAP *
 findlongestpath(GRID *g, int t)
+{
+  return findlongestpathby(g, t, LONGEST_FLOOD);
+} /* findlongestpath() */
+
+/* findlongestpath() with a choice of method. LONGEST_FLOOD uses two
+ * flood fills and works on any maze. LONGEST_TREE does a single pass
+ * but only works on perfect mazes (returns NULL if there's a loop).
+ * LONGEST_DETECT tries the tree method and falls back to flood fills
+ * if a loop is found.
+ */
+DMAP *
+findlongestpathby(GRID *g, int t, int method)
 {
   DMAP *first, *second;
   CELL *pa, *pb;
@@ -289,6 +1200,13 @@ findlongestpath(GRID *g, int t)
     hid ++;
   } while (pa->ctype != t);
 
+  if(method != LONGEST_FLOOD) {
+    second = longesttree(g, pa);
+    if(second || (method == LONGEST_TREE)) {
+      return second;
+    }
+  }
+
   /* Hunt from SE for first cell */
   hid = g->max - 1;
   do {
@@ -316,10 +1234,13 @@ findlongestpath(GRID *g, int t)
     /* Point A was id 0, if the furthest point from Point A is
      * Point A, we've got a real degenerate case.
      */
-    TRAIL *walk = (TRAIL *)malloc( sizeof(TRAIL) );
-    walk->next = walk->prev = NULL;
-    walk->cell_id = fid;
-    first->path = walk;
+    first->pathids = (int *)malloc( sizeof(int) );
+    if(!first->pathids) {
+      freedistancemap(first);
+      return NULL;
+    }
+    first->pathids[0] = fid;
+    first->pathlen = 1;
     return first;
   }
 
@@ -348,12 +1269,11 @@ findlongestpath(GRID *g, int t)
   }
 
   return second;
-} /* findlongestpath() */
+} /* findlongestpathby() */
 
 int
 iteratewalk(DMAP *dm, int(*ifunc)(DMAP *, int, void*), void*param)
 {
-  TRAIL *step;
   int sum = 0;
 
   if(!dm) {
@@ -362,15 +1282,13 @@ iteratewalk(DMAP *dm, int(*ifunc)(DMAP *, int, void*), void*param)
   if(!ifunc) {
     return -1;
   }
-  if(!dm->path) {
+  if(!dm->pathlen) {
     return -1;
   }
 
-  step = dm->path;
-  do {
-    sum += ifunc(dm, step->cell_id, param);
-    step = step->next;
-  } while(step);
+  for(int step = 0; step < dm->pathlen; step ++) {
+    sum += ifunc(dm, dm->pathids[step], param);
+  }
   
   return sum;
 } /* iteratewalk() */
@@ -390,6 +1308,35 @@ namewalker(DMAP *dm, int cid, void*param)
   return 0;
 } /* namewalker() */
 
+/* Builds (once) and returns the old linked list form of a path found by
+ * findpath(), for code that wants to walk a TRAIL. The list belongs to
+ * the distance map. Returns NULL if there is no path or on malloc failure.
+ */
+TRAIL *
+pathtrail(DMAP *dm)
+{
+  TRAIL *step, *tail;
+
+  if(!dm) { return NULL; }
+  if(dm->path) { return dm->path; }
+
+  tail = NULL;
+  for(int i = 0; i < dm->pathlen; i ++) {
+    step = (TRAIL *)malloc( sizeof(TRAIL) );
+    if(!step) {
+      freetrail(dm);
+      return NULL;
+    }
+    step->cell_id = dm->pathids[i];
+    step->next = NULL;
+    step->prev = tail;
+    if(tail) { tail->next = step; } else { dm->path = step; }
+    tail = step;
+  }
+
+  return dm->path;
+} /* pathtrail() */
+
 /* Insert a name into all of the steps on a path
  * if name is NULL stringify the step count, and use that.
  * The three names are first (first step only), middle,
@@ -410,8 +1357,231 @@ namepath(DMAP *dm, char *fname, char *mname, char *lname)
   if(lname) {
     namebyid(dm->grid, dm->target_id, lname);
   }
+  return 0;
 } /* namepath */
 
+/* Tree maps: for perfect mazes (every cell reachable by exactly one
+ * route) the maze is a spanning tree, so the distance between any two
+ * cells is depth(a) + depth(b) - 2 * depth(lowest common ancestor).
+ * The ancestor is found with a range minimum query over an Euler tour
+ * of the tree, using a sparse table. Building is O(n log n), after
+ * which each distance query is O(1) and never touches the grid.
+ */
+
+/* floor(log2(n)) for n > 0 */
+static
+int
+treelog2(int n)
+{
+#ifdef __GNUC__
+  return 31 - __builtin_clz((unsigned)n);
+#else
+  int l = 0;
+  while(n >>= 1) { l ++; }
+  return l;
+#endif
+} /* treelog2() */
+
+/* Walks the maze from root depth first, recording parents, depths and
+ * the Euler tour, then builds the sparse table over the tour.
+ * Cells not reachable from root get a depth of NV. Returns NULL if
+ * a loop is found (not a tree) or on malloc failure.
+ */
+TREEMAP *
+createtreemap(GRID *g, CELL *root)
+{
+  TREEMAP *tm;
+  int *stack, *nextdir;
+  int sp, n, m, id, nid, go;
+  int *prev, *cur;
+
+  if(!g) { return NULL; }
+  if(!root) { return NULL; }
+  if((root->id < 0) || (root->id >= g->max)) { return NULL; }
+
+  n = g->max;
+  tm = (TREEMAP *)calloc(1, sizeof(TREEMAP));
+  if(!tm) { return NULL; }
+
+  tm->grid    = g;
+  tm->root_id = root->id;
+  tm->msize   = n;
+  tm->parent  = (int *)malloc( n * sizeof(int) );
+  tm->depth   = (int *)malloc( n * sizeof(int) );
+  tm->first   = (int *)malloc( n * sizeof(int) );
+  tm->euler   = (int *)malloc( 2 * n * sizeof(int) );
+  stack       = (int *)malloc( n * sizeof(int) );
+  nextdir     = (int *)malloc( n * sizeof(int) );
+
+  if(!tm->parent || !tm->depth || !tm->first || !tm->euler ||
+     !stack || !nextdir) {
+    free(stack);
+    free(nextdir);
+    freetreemap(tm);
+    return NULL;
+  }
+
+  for(int i = 0; i < n; i ++) {
+    tm->parent[i] = NC;
+    tm->depth[i]  = NV;
+    tm->first[i]  = NV;
+  }
+
+  m = 0;
+  sp = 0;
+  id = root->id;
+  tm->depth[id] = 0;
+  tm->first[id] = m;
+  tm->euler[m++] = id;
+  tm->count = 1;
+  stack[sp] = id;
+  nextdir[sp] = FIRSTDIR;
+  sp ++;
+
+  while(sp) {
+    id = stack[sp - 1];
+    go = nextdir[sp - 1];
+
+    if(go == FOURDIRECTIONS) {
+      /* done with this cell, back to the parent */
+      sp --;
+      if(sp) { tm->euler[m++] = stack[sp - 1]; }
+      continue;
+    }
+    nextdir[sp - 1] ++;
+
+    nid = openneighbor(g, quickvisitid(g, id), go);
+    if((nid == NC) || (nid == tm->parent[id])) { continue; }
+
+    if(tm->depth[nid] != NV) {
+      /* reached a second way: has a loop */
+      free(stack);
+      free(nextdir);
+      freetreemap(tm);
+      return NULL;
+    }
+
+    tm->parent[nid] = id;
+    tm->depth[nid]  = tm->depth[id] + 1;
+    tm->first[nid]  = m;
+    tm->euler[m++]  = nid;
+    tm->count ++;
+
+    stack[sp] = nid;
+    nextdir[sp] = FIRSTDIR;
+    sp ++;
+  }
+  free(stack);
+  free(nextdir);
+
+  tm->tourlen = m;
+  tm->levels  = treelog2(m) + 1;
+  tm->sparse  = (int *)malloc( tm->levels * m * sizeof(int) );
+  if(!tm->sparse) {
+    freetreemap(tm);
+    return NULL;
+  }
+
+  /* level k, position i: shallowest cell in euler[i .. i + 2^k - 1] */
+  memcpy(tm->sparse, tm->euler, m * sizeof(int));
+  for(int k = 1; k < tm->levels; k ++) {
+    int half = 1 << (k - 1);
+    prev = tm->sparse + (k - 1) * m;
+    cur  = tm->sparse + k * m;
+    for(int i = 0; i + (1 << k) <= m; i ++) {
+      int a = prev[i];
+      int b = prev[i + half];
+      cur[i] = (tm->depth[a] <= tm->depth[b])? a: b;
+    }
+  }
+
+  return tm;
+} /* createtreemap() */
+
+void
+freetreemap(TREEMAP *tm)
+{
+  if(!tm) { return; }
+  if(tm->parent) { free (tm->parent); }
+  if(tm->depth)  { free (tm->depth); }
+  if(tm->first)  { free (tm->first); }
+  if(tm->euler)  { free (tm->euler); }
+  if(tm->sparse) { free (tm->sparse); }
+  free(tm);
+} /* freetreemap() */
+
+/* Lowest common ancestor of two cells, relative to the tree map root.
+ * Returns DISTANCE_ERROR for bad ids and DISTANCE_NOPATH if either
+ * cell is not in the tree.
+ */
+int
+treeancestor(TREEMAP *tm, int id1, int id2)
+{
+  int lo, hi, k, a, b;
+
+  if(!tm) { return DISTANCE_ERROR; }
+  if((id1 < 0) || (id1 >= tm->msize)) { return DISTANCE_ERROR; }
+  if((id2 < 0) || (id2 >= tm->msize)) { return DISTANCE_ERROR; }
+  if((tm->depth[id1] == NV) || (tm->depth[id2] == NV)) {
+    return DISTANCE_NOPATH;
+  }
+
+  lo = tm->first[id1];
+  hi = tm->first[id2];
+  if(lo > hi) { k = lo; lo = hi; hi = k; }
+
+  k = treelog2(hi - lo + 1);
+  a = tm->sparse[k * tm->tourlen + lo];
+  b = tm->sparse[k * tm->tourlen + hi - (1 << k) + 1];
+  return (tm->depth[a] <= tm->depth[b])? a: b;
+} /* treeancestor() */
+
+/* Distance between any two cells in the tree, without a flood fill.
+ * Returns DISTANCE_ERROR for bad ids and DISTANCE_NOPATH if either
+ * cell is not in the tree.
+ */
+int
+treedistance(TREEMAP *tm, int id1, int id2)
+{
+  int lca;
+
+  lca = treeancestor(tm, id1, id2);
+  if(lca < 0) { return lca; }
+
+  return tm->depth[id1] + tm->depth[id2] - 2 * tm->depth[lca];
+} /* treedistance() */
+
+/* Fills in path with the cell ids from id1 to id2, inclusive. The
+ * path array must have room for treedistance() + 1 ids. Returns the
+ * number of ids in the path, or a negative value like treedistance().
+ */
+int
+treepath(TREEMAP *tm, int id1, int id2, int *path)
+{
+  int lca, len, i;
+
+  if(!path) { return DISTANCE_ERROR; }
+  lca = treeancestor(tm, id1, id2);
+  if(lca < 0) { return lca; }
+
+  len = tm->depth[id1] + tm->depth[id2] - 2 * tm->depth[lca] + 1;
+
+  /* climb from id1 filling from the front, and from id2 from the back */
+  i = 0;
+  while(id1 != lca) {
+    path[i++] = id1;
+    id1 = tm->parent[id1];
+  }
+  path[i] = lca;
+  i = len - 1;
+  while(id2 != lca) {
+    path[i--] = id2;
+    id2 = tm->parent[id2];
+  }
+
+  return len;
+} /* treepath() */
+
 /* print the distance map for testing */
 void
 ascii_dmap(DMAP *dm)
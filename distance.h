@@ -6,6 +6,11 @@
 #define DISTANCE_NOPATH   -1
 #define DISTANCE_ERROR    -2
 
+/* methods for findlongestpathby() */
+#define LONGEST_FLOOD      0	/* two flood fills, any maze */
+#define LONGEST_TREE       1	/* one pass, perfect mazes only */
+#define LONGEST_DETECT     2	/* tree if possible, else flood */
+
 #define NV                -2	/* no value or not visited */
 #define NOT_VISITED       NV
 #define FRONTIER          -3
@@ -28,16 +33,52 @@ typedef struct {
   int msize;		/* size of map; frontier always one larger */
   int *map;		/* distances from root, indexed by cell id */
   int *frontier;	/* cells to check when looking for a target */
-  TRAIL *path;		/* linked list of a path from root to target */
+  int *nextfrontier;	/* cells to check next round, swapped with frontier */
+  int *pathids;		/* cell ids of a path from root to target */
+  int pathlen;		/* number of cell ids in pathids */
+  TRAIL *path;		/* linked list version of path, see pathtrail() */
+  int *scratch;		/* point to point solver space, all NV between uses */
+  unsigned char *openbits; /* bit per open direction, diroptdistanceto() */
 } DMAP;
 
+/* Euler tour index of a perfect maze (a spanning tree) for answering
+ * distance questions between any two cells without a flood fill.
+ * Also read-only for users.
+ */
+typedef struct {
+  GRID *grid;
+  int root_id;		/* where the tree was walked from */
+  int msize;		/* size of per-cell arrays, same as grid max */
+  int count;		/* cells reachable from root */
+  int *parent;		/* parent cell id, NC for root and unreached */
+  int *depth;		/* distance from root, NV if unreached */
+  int *first;		/* first position of each cell in euler tour */
+  int *euler;		/* cell ids in depth first visiting order */
+  int tourlen;		/* length of euler, 2 * count - 1 */
+  int levels;		/* levels in sparse table */
+  int *sparse;		/* levels * tourlen shallowest cell ids */
+} TREEMAP;
+
 
 DMAP *createdistancemap(GRID *, CELL *);
+int resetdistancemap(DMAP *, CELL *);
 void freedistancemap(DMAP *);
 
 int distanceto(DMAP *, CELL *,int /* lazy flag */);
+int pdistanceto(DMAP *, CELL *,int /* threads */);
+int diroptdistanceto(DMAP *, CELL *,int /* lazy flag */);
+int bidistanceto(DMAP *, CELL *);
+int astardistanceto(DMAP *, CELL *);
 int findpath(DMAP *);
+TRAIL *pathtrail(DMAP *);
 DMAP *findlongestpath(GRID *, int /*celltype*/);
+DMAP *findlongestpathby(GRID *, int /*celltype*/, int /*method*/);
+
+TREEMAP *createtreemap(GRID *, CELL */*root*/);
+void freetreemap(TREEMAP *);
+int treeancestor(TREEMAP *, int, int);
+int treedistance(TREEMAP *, int, int);
+int treepath(TREEMAP *, int, int, int */*path*/);
 
 int iteratewalk(DMAP *, int(*)(DMAP *, int, void*), void*);
 int namepath(DMAP *, char */*first*/, char */*middle*/, char*/*last*/);
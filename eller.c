@@ -0,0 +1,36 @@
+/* Eller's algorithm maze, streamed.
+ *
+ * Unlike the other demos this never builds a GRID: each row is printed
+ * as soon as it is finished, and memory use depends only on the width.
+ * So it can print mazes far taller than would fit in memory.
+ *
+ * Usage: eller [rows [cols [seed]]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "grid.h"
+#include "mazes.h"
+
+int
+main(int argc, char**argv)
+{
+  int rows = 10, cols = 10;
+  uint64_t seed = (uint64_t)time(NULL);
+
+  if(argc > 1) { rows = atoi(argv[1]); }
+  if(argc > 2) { cols = atoi(argv[2]); }
+  if(argc > 3) { seed = strtoull(argv[3], NULL, 10); }
+  if((rows < 1) || (cols < 1)) {
+    fprintf(stderr, "Usage: eller [rows [cols [seed]]]\n");
+    return 2;
+  }
+
+  if(eller(rows, cols, seed, ellerasciirow, stdout)) {
+    fprintf(stderr, "eller: failed\n");
+    return 1;
+  }
+  return 0;
+}
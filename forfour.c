@@ -235,7 +235,7 @@ colors(color_overide_t usercolors)
  *
  * A drawmaze() callback, a bit more complicated with the solution
  * code than default_drawcell() in mazeimgs.c, but also a bit
- * simpler in only supporting RGB color.
+ * simpler in only supporting 8 bit RGB or palette color.
  */
 int
 cleandraw(MAZEBITMAP *mb, png_byte *image, CELL *c)
@@ -404,3 +404,31 @@ cleandraw(MAZEBITMAP *mb, png_byte *image, CELL *c)
   return 1;
 } /* cleandraw(); */
 
+
+/* The drawmaze() tile cache key for cleandraw(). The entrance and exit
+ * cells are drawn fresh, everything else is keyed by walls, edges, and
+ * when drawing the solution, which neighbors are off the path.
+ */
+int
+cleankey(MAZEBITMAP *mb, CELL *c)
+{
+  GRID *g = mb->dmap->grid;
+  CELL *overthere;
+  int key;
+
+  if((c->id == 0) || (c->id == (g->max - 1))) {
+    return -1;
+  }
+
+  key = (wallstatusbycell(c) & 0xf) | ((edgestatusbycell(g, c) & 0xf) << 4);
+  if((c->ctype == SOLVEDCELL) && (g->gtype == SOLVEDCELL)) {
+    key |= 0x100;
+    for(int go = FIRSTDIR; go < FOURDIRECTIONS; go++) {
+      overthere = visitdir(g, c, go, THIS);
+      if(overthere && (overthere->ctype != SOLVEDCELL)) {
+        key |= 0x200 << go;
+      }
+    }
+  }
+  return key;
+} /* cleankey() */
@@ -19,5 +19,6 @@ int proffir(char);
 void copycolor(color_overide_t /* usercolors */, char, char *);
 COLORDATA *colors(color_overide_t /* usercolors */);
 int cleandraw(MAZEBITMAP *, png_byte *, CELL *);
+int cleankey(MAZEBITMAP *, CELL *);
 
 #endif /* _FORFOUR_H */
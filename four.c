@@ -200,7 +200,7 @@ main(int argc, char**argv)
     return 2;
   }
 
-  mazetype = random() % 4;
+  mazetype = gridrandrange(maing, 4);
   superg = createamaze(4, mazetype);
   if(!superg) {
     fprintf(stderr, "Super create failed (type %d)\n", mazetype);
@@ -232,7 +232,7 @@ main(int argc, char**argv)
       if(r != 0) {
         /* not row zero, maybe connect this tile to one above */
 	if(NC != superc->dir[NORTH]) {
-	  rn = random() % (tilesize - 1);
+	  rn = gridrandrange(maing, tilesize - 1);
 	  connectbyrc(maing, i - 1, j + rn, SOUTH, i, j + rn, NORTH);
 	}
       }
@@ -240,7 +240,7 @@ main(int argc, char**argv)
       if(c != 0) {
         /* not column zero, maybe connect this tile to one to left */
 	if(NC != superc->dir[WEST]) {
-	  rn = random() % (tilesize - 1);
+	  rn = gridrandrange(maing, tilesize - 1);
 	  connectbyrc(maing, i + rn, j - 1, EAST, i + rn, j, WEST);
 	}
       }
@@ -281,7 +281,8 @@ main(int argc, char**argv)
     return 2;
   }
 
-  rc = initmazebitmap(mb, cellsize, cellsize, COLOR_RGB, 8, CELL_SIZE);
+  /* four only ever uses the eight COLORDATA colors, so a 4 bit palette */
+  rc = initmazebitmap(mb, cellsize, cellsize, COLOR_PALETTE, 4, CELL_SIZE);
   /* 0 is acceptable for non-png output */
   if(rc != 1) {
     fprintf(stderr, "Init mazebitmap failed; gonna guess memory.\n");
@@ -294,11 +295,16 @@ main(int argc, char**argv)
     free(board);
   }
 
-  /* set our callback */
+  /* set our callbacks */
   mb->cellfunc  = (CELLFUNC_P) cleandraw;
+  mb->cellkey   = (CELLKEY_P) cleankey;
 
-  /* store our colors in the maze */
+  /* store our colors in the maze, as palette indices */
   mb->udata = colors(usercolors);
+  if(setpalette(mb, mb->udata) < 0) {
+    fprintf(stderr, "Palette setup failed.\n");
+    return 2;
+  }
 
   filename = (char*) malloc( BUFSIZ );
   if(!filename) {
@@ -128,7 +128,7 @@ creategrid(int i, int j, int t)
 {
   GRID *g;
   int count;
-  static int grid_ran_srandom = 0;
+  static uint64_t grids_made = 0;
 
   if((i < 1) || (j < 1)) {
     return (GRID*)NULL;
@@ -145,16 +145,16 @@ creategrid(int i, int j, int t)
   g->data = NULL;
   g->name = NULL;
   g->max = count;
+  g->plane = NULL;
   g->cells = createcells(g->rows, g->cols, t, 1);
   if(!g->cells) {
     free(g);
     return (GRID*)NULL;
   }
 
-  if(!grid_ran_srandom) {
-    grid_ran_srandom = (int)time(NULL);
-    srandom(grid_ran_srandom);
-  }
+  /* grids made in the same second still get different mazes */
+  seedgrid(g, (uint64_t)time(NULL) ^
+              (__atomic_fetch_add(&grids_made, 1, __ATOMIC_RELAXED) << 32));
 
   return g;
 } /* creategrid() */
@@ -175,11 +175,72 @@ freegrid(GRID* g)
     }
     free(g->cells);
   }
+  disableplane(g);
 
   free(g);
 } /* freegrid() */
 
 
+/* Connectivity plane: a packed nibble per cell, bit d set when
+ * dir[d] != NC for the four compass directions. Once enabled, the
+ * byrc and byid connect and disconnect functions keep it in sync. The
+ * bycell ones don't know the grid, so anything using them or writing
+ * dir[] directly should call rebuildplane() after.
+ * Returns 0 on success, -1 on failure.
+ */
+int
+enableplane(GRID *g)
+{
+  if(!g) { return -1; }
+  if(!g->plane) {
+    g->plane = (unsigned char *)malloc( ((size_t)g->max + 1) / 2 );
+    if(!g->plane) { return -1; }
+  }
+  rebuildplane(g);
+  return 0;
+} /* enableplane() */
+
+void
+disableplane(GRID *g)
+{
+  if(!g) { return; }
+  if(!g->plane) { return; }
+  free(g->plane);
+  g->plane = NULL;
+} /* disableplane() */
+
+/* recomputes the plane nibble of one cell, if the grid has a plane */
+static
+void
+planesync(GRID *g, CELL *c)
+{
+  int bits = 0;
+  int shift;
+
+  if(!g->plane || !c) { return; }
+
+  for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+    if(c->dir[go] != NC) { bits |= 1 << go; }
+  }
+  shift = (c->id & 1) << 2;
+  g->plane[c->id >> 1] = (g->plane[c->id >> 1] & ~(0xf << shift)) |
+                         (bits << shift);
+} /* planesync() */
+
+/* recomputes the whole plane from the cells */
+void
+rebuildplane(GRID *g)
+{
+  if(!g) { return; }
+  if(!g->plane) { return; }
+
+  memset(g->plane, 0, ((size_t)g->max + 1) / 2);
+  for(int id = 0; id < g->max; id ++) {
+    planesync(g, &(g->cells[id]));
+  }
+} /* rebuildplane() */
+
+
 /* Perform a deep copy of an entire grid. If includeuserdata is set
  * the pointers for the user data will be copied (since userdata is
  * opaque, we can't copy the actual contents).
@@ -227,6 +288,11 @@ copygrid(GRID *g, int includeuserdata)
     }
   }
 
+  if(g->plane && enableplane(dupe)) {
+    freegrid(dupe);
+    return NULL;
+  }
+
   return dupe;
 } /* copygrid() */
 
@@ -276,6 +342,7 @@ pasteintogrid(GRID *sg, GRID *dg, int top, int left, int includeuserdata)
     }
   } /* copy the cells */
 
+  rebuildplane(dg);
   return rc;
 } /* pasteintogrid() */
 
@@ -429,6 +496,11 @@ labyrinthgrid(GRID *g, int cid)
     } /* for source column */
   } /* for source row */
 
+  if(g->plane && enableplane(lg)) {
+    freegrid(lg);
+    return NULL;
+  }
+
   return lg;
 } /* labyrinthgrid() */
 
@@ -621,6 +693,7 @@ rotategrid(GRID *g, int rotation)
   g->cols = ncols;
   free(g->cells);
   g->cells = block;
+  rebuildplane(g);
 
   return 0;
 } /* rotategrid() */
@@ -742,9 +815,80 @@ visitrandom(GRID *g)
 {
   if(!g) { return (CELL*)NULL; }
   
-  return visitid(g, random() % g->max);
+  return visitid(g, gridrandrange(g, g->max));
 }
 
+/* splitmix64, used to spread a seed over the xoshiro state */
+static uint64_t
+splitmix(uint64_t *x)
+{
+  uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+} /* splitmix() */
+
+/* (re)seed a free standing random number state, for code working
+ * without a grid (or with several streams per grid)
+ */
+void
+seedrng(uint64_t *rng, uint64_t seed)
+{
+  for(int i = 0; i < 4; i ++) {
+    rng[i] = splitmix(&seed);
+  }
+} /* seedrng() */
+
+#define ROTL64(x,k)	( ((x) << (k)) | ((x) >> (64 - (k))) )
+
+/* 32 random bits from a xoshiro256** state */
+uint32_t
+rngrandom(uint64_t *s)
+{
+  uint64_t result = ROTL64(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = ROTL64(s[3], 45);
+
+  return (uint32_t)(result >> 32);
+} /* rngrandom() */
+
+/* random number 0 to n-1, by multiply and shift rather than modulo */
+int
+rngrange(uint64_t *rng, int n)
+{
+  return (int)(((uint64_t)rngrandom(rng) * (uint32_t)n) >> 32);
+} /* rngrange() */
+
+/* (re)seed the random numbers of one grid, same seed gives same mazes */
+void
+seedgrid(GRID *g, uint64_t seed)
+{
+  if(!g) { return; }
+  seedrng(g->rng, seed);
+} /* seedgrid() */
+
+/* 32 random bits from the grid's own state; no locks, so different
+ * grids can be worked on in different threads
+ */
+uint32_t
+gridrandom(GRID *g)
+{
+  return rngrandom(g->rng);
+} /* gridrandom() */
+
+/* random number 0 to n-1 from the grid's own state */
+int
+gridrandrange(GRID *g, int n)
+{
+  return rngrange(g->rng, n);
+} /* gridrandrange() */
+
 /* {FOO}bycell functions use one or two CELL pointers
  * {FOO}byrc functions take GRID and one or two pairs of row,col
  * {FOO}byid functions take GRID and one or two ids
@@ -784,17 +928,27 @@ connectbycell(CELL *c1, int c1c2d, CELL * c2, int c2c1d)
 void connectbyrc(GRID *g, int r1, int c1, int c1c2d,
                           int r2, int c2, int c2c1d)
 {
+  CELL *a, *b;
+
   if(!g) { return; }
-  connectbycell(visitrc(g, r1, c1), c1c2d,
-                visitrc(g, r2, c2), c2c1d);
+  a = visitrc(g, r1, c1);
+  b = visitrc(g, r2, c2);
+  connectbycell(a, c1c2d, b, c2c1d);
+  planesync(g, a);
+  planesync(g, b);
 } /* connectbyrc() */
 
 void connectbyid(GRID *g, int id1, int c1c2d,
                           int id2, int c2c1d)
 {
+  CELL *a, *b;
+
   if(!g) { return; }
-  connectbycell(visitid(g, id1), c1c2d,
-                visitid(g, id2), c2c1d);
+  a = visitid(g, id1);
+  b = visitid(g, id2);
+  connectbycell(a, c1c2d, b, c2c1d);
+  planesync(g, a);
+  planesync(g, b);
 } /* connectbyid() */
 
 
@@ -829,18 +983,28 @@ void
 disconnectbyrc(GRID *g, int r1, int c1, int c1c2d,
                         int r2, int c2, int c2c1d)
 {
+  CELL *a, *b;
+
   if(!g) { return; }
-  disconnectbycell(visitrc(g, r1, c1), c1c2d,
-                   visitrc(g, r2, c2), c2c1d);
+  a = visitrc(g, r1, c1);
+  b = visitrc(g, r2, c2);
+  disconnectbycell(a, c1c2d, b, c2c1d);
+  planesync(g, a);
+  planesync(g, b);
 } /* disconnectbyrc() */
 
 void
 disconnectbyid(GRID *g, int id1, int c1c2d,
                         int id2, int c2c1d)
 {
+  CELL *a, *b;
+
   if(!g) { return; }
-  disconnectbycell(visitid(g, id1), c1c2d,
-                   visitid(g, id2), c2c1d);
+  a = visitid(g, id1);
+  b = visitid(g, id2);
+  disconnectbycell(a, c1c2d, b, c2c1d);
+  planesync(g, a);
+  planesync(g, b);
 } /* disconnectbyid() */
 
 
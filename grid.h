@@ -4,6 +4,8 @@
 #ifndef _GRID_H
 #define _GRID_H
 
+#include <stdint.h>
+
 #define DIRECTIONS      6
 #define FOURDIRECTIONS  4	/* without up / down */
 #define FIRSTDIR        0
@@ -112,6 +114,12 @@ typedef struct
    void *data;	/* for user use to hold arbitrary structures */
 
    CELL *cells;
+
+   /* optional packed connectivity, see enableplane() */
+   unsigned char *plane;
+
+   /* random number state for this grid, see seedgrid() */
+   uint64_t rng[4];
 } GRID;
 
 typedef struct cellcopyconfig_s {
@@ -134,31 +142,63 @@ int pasteintogrid(GRID * /* src */, GRID * /* dest */,
 	int /* top */, int /* left */, int /* includeuserdata */);
 GRID *labyrinthgrid(GRID *, int /* entranceid */);
 
+/* connectivity plane: a nibble per cell, bit d set if dir[d] != NC
+ * for NORTH, WEST, EAST, SOUTH. Kept in sync by the byrc / byid connect
+ * and disconnect functions once enabled, but not the bycell ones.
+ */
+int enableplane(GRID *);
+void disableplane(GRID *);
+void rebuildplane(GRID *);
+#define planebits(g,id)     ( ((g)->plane[(id) >> 1] >> (((id) & 1) << 2)) & 0xf )
+#define planeopen(g,id,d)   ( (planebits(g,id) >> (d)) & 1 )
+
 /* visit functions return a CELL pointer */
 /* visitid() is the fastest of the lot */
-/* macro versions should be faster than function versions */
+/* inline versions should be faster than function versions, and like
+ * the functions they are reentrant (safe to use on several grids in
+ * several threads at once)
+ */
 #ifdef VISIT_FUNCTIONS
 CELL *visitrc(GRID *, int /*rows*/, int /*cols*/);
 CELL *visitid(GRID *, int /*cellid*/);
 #else  /* VISIT_FUNCTIONS */
-static int macro_id,macro_i,macro_j;
-static GRID *macro_g;
-#define visitrc(g,i,j)  ( macro_g=(g), macro_i = (i), macro_j = (j),                 \
-                          (!macro_g || (macro_i < 0) || (macro_i >= macro_g->rows)   \
-                                    || (macro_j < 0) || (macro_j >= macro_g->cols))  \
-			  ?   (CELL*)NULL                                            \
-			  :   &(macro_g->cells[macro_g->cols*macro_i+macro_j])       \
-			)
-
-#define visitid(g,id)   ( macro_g=(g), macro_id = (id),         \
-                          (!g || (id < 0) || (id >= g->max) )   \
-				? (CELL*)NULL                   \
-				: &(g->cells[id])               \
-			)
+static inline CELL *
+visitrc(GRID *g, int i, int j)
+{
+  if(!g || (i < 0) || (i >= g->rows) || (j < 0) || (j >= g->cols)) {
+    return (CELL*)NULL;
+  }
+  return &(g->cells[g->cols * i + j]);
+}
+
+static inline CELL *
+visitid(GRID *g, int id)
+{
+  if(!g || (id < 0) || (id >= g->max)) {
+    return (CELL*)NULL;
+  }
+  return &(g->cells[id]);
+}
 #endif
+
+/* Unchecked versions for inner loops: the grid must exist and the
+ * cell must be on it, or the results are undefined.
+ */
+#define quickvisitrc(g,i,j)	( &((g)->cells[(g)->cols * (i) + (j)]) )
+#define quickvisitid(g,id)	( &((g)->cells[(id)]) )
+
 CELL *visitdir(GRID *, CELL */*cell*/, int/*direction*/, int/* connection status */);
 CELL *visitrandom(GRID *);
 
+/* per grid random numbers (xoshiro256**), seeded by creategrid() */
+void seedgrid(GRID *, uint64_t /*seed*/);
+uint32_t gridrandom(GRID *);
+int gridrandrange(GRID *, int /*n*/);
+/* the same generator on a bare uint64_t[4] state */
+void seedrng(uint64_t * /*rng*/, uint64_t /*seed*/);
+uint32_t rngrandom(uint64_t * /*rng*/);
+int rngrange(uint64_t * /*rng*/, int /*n*/);
+
 
 /* bycell functions use one or two CELL pointers
  * byrc functions take GRID and one or two pairs of row,col
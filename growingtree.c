@@ -0,0 +1,82 @@
+/* Growing tree mazes: carve from a set of active cells, with the
+ * choice of which active cell to grow next setting the texture.
+ *
+ * Usage: growingtree [newest|random|oldest|mixed]
+ *
+ * Example (mixed) maze:
+ *
+ * +---+---+---+---+---+---+---+---+---+---+
+ * |       |               |   |   |       |
+ * +   +   +---+   +   +---+   +   +---+   +
+ * |   |       |   |   |                   |
+ * +   +   +---+   +   +---+---+   +   +   +
+ * |   |           |   |           |   |   |
+ * +---+---+   +---+   +---+---+---+   +---+
+ * |   |   |       |   |   |   |           |
+ * +   +   +   +---+---+   +   +---+---+   +
+ * |   |       |   |       |       |       |
+ * +   +   +---+   +---+   +   +---+   +---+
+ * |           |   |   |                   |
+ * +   +   +---+   +   +---+---+---+---+   +
+ * |   |           |           |           |
+ * +---+   +---+   +---+---+   +   +---+   +
+ * |       |       |       |       |   |   |
+ * +   +---+---+   +   +---+   +   +   +---+
+ * |   |                       |           |
+ * +   +---+---+---+   +---+---+   +---+---+
+ * |               |       |               |
+ * +---+---+---+---+---+---+---+---+---+---+
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mazes.h"
+
+static const char *policies[] = { "newest", "random", "oldest", "mixed" };
+
+int
+main(int argc, char**argv)
+{
+  GRID *g;
+  DMAP *dm;
+  char *board;
+  int rc, policy = GROW_MIXED;
+
+  if(argc > 1) {
+    for(policy = GROW_NEWEST; policy <= GROW_MIXED; policy ++) {
+      if(!strcmp(argv[1], policies[policy])) { break; }
+    }
+    if(policy > GROW_MIXED) {
+      fprintf(stderr, "Usage: growingtree [newest|random|oldest|mixed]\n");
+      return 2;
+    }
+  }
+
+  g = creategrid(10, 10, UNVISITED);
+  rc = growingtree(g, NULL, policy);
+  if(rc) {
+    printf("Um, issue.\n");
+  }
+
+  printf("Unsolved (%s)\n", policies[policy]);
+  board = ascii_grid(g, 0);
+  puts(board);
+  free(board);
+
+  dm = findlongestpathby(g, VISITED, LONGEST_DETECT);
+  if(!dm) {
+    printf("Ooops, solver broke\n");
+  }
+  namepath(dm, " A", " x", " B");
+
+  printf("\nSolved (for longest possible path)\n");
+  board = ascii_grid(g, 1);
+  puts(board);
+  free(board);
+
+  freegrid(g);
+  return 0;
+}
@@ -112,7 +112,7 @@ main(int notused, char**ignored)
   free(board);
 
   CELL *c = visitid(g, 8);
-  dm = findlongestpath(g, VISITED);
+  dm = findlongestpathby(g, VISITED, LONGEST_DETECT);
   if(!dm) {
     printf("Ooops, solver broke\n");
   }
@@ -0,0 +1,68 @@
+/* Randomized Kruskal's algorithm, an edge based maze: walls are taken
+ * down in random order unless the cells either side are already
+ * joined. The run time doesn't depend on the luck of a random walk.
+ *
+ * Example maze:
+ *
+ * +---+---+---+---+---+---+---+---+---+---+
+ * |   |       |       |               |   |
+ * +   +---+   +   +---+   +---+---+---+   +
+ * |               |                       |
+ * +---+---+---+   +---+---+---+   +   +---+
+ * |   |                           |       |
+ * +   +   +   +---+---+   +   +   +---+---+
+ * |       |   |   |       |   |   |       |
+ * +---+   +---+   +---+   +---+---+   +   +
+ * |   |       |       |   |           |   |
+ * +   +---+   +   +---+   +   +   +---+   +
+ * |   |       |   |       |   |   |       |
+ * +   +---+   +   +   +   +---+---+   +---+
+ * |   |       |       |           |       |
+ * +   +   +   +---+---+   +   +---+   +   +
+ * |       |   |       |   |   |       |   |
+ * +---+   +---+   +---+   +---+   +---+---+
+ * |       |           |       |           |
+ * +   +---+   +---+   +   +   +   +---+   +
+ * |       |   |           |       |       |
+ * +---+---+---+---+---+---+---+---+---+---+
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mazes.h"
+
+
+int
+main(int notused, char**ignored)
+{
+  GRID *g;
+  DMAP *dm;
+  char *board;
+  int rc;
+
+  g = creategrid(10, 10, UNVISITED);
+  rc = kruskal(g, NULL);
+  if(rc) {
+    printf("Um, issue.\n");
+  }
+
+  printf("Unsolved\n");
+  board = ascii_grid(g, 0);
+  puts(board);
+  free(board);
+
+  dm = findlongestpathby(g, VISITED, LONGEST_DETECT);
+  if(!dm) {
+    printf("Ooops, solver broke\n");
+  }
+  namepath(dm, " A", " x", " B");
+
+  printf("\nSolved (for longest possible path)\n");
+  board = ascii_grid(g, 1);
+  puts(board);
+  free(board);
+
+  freegrid(g);
+  return 0;
+}
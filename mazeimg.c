@@ -1,8 +1,12 @@
 /* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
 /* ways to make a maze grid into an image */
-/* uses libpng.h */
+/* uses libpng.h and zlib.h */
 
+#include <limits.h>
+#include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
 
 #include "mazeimg.h"
 
@@ -36,7 +40,11 @@ createmazebitmap(DMAP *dm)
   mb->rowsp    = (png_bytep*)NULL;
   mb->cellfunc = NULL;
   mb->colorfunc = NULL;
+  mb->cellkey  = NULL;
   mb->udata    = NULL;
+  mb->palettesize = 0;
+  mb->zlevel   = ZLEVEL_DEFAULT;
+  mb->filter   = FILTER_DEFAULT;
 
   return mb;
 } /* createmazebitmap() */
@@ -59,15 +67,84 @@ freemazebitmap(MAZEBITMAP *mb)
 } /* freemazebitmap() */
 
 
+/* The palette default_colorpicker() expects, from the RGB defaults. At
+ * 1 bit there is room for two colors, background and the edge color for
+ * every line.
+ */
+static void
+defaultpalette(MAZEBITMAP *mb)
+{
+  if(mb->colordepth == 1) {
+    mb->palette[PAL1_BG]   = (png_color) { R_BG, G_BG, B_BG };
+    mb->palette[PAL1_LINE] = (png_color) { R_EDGE_LINE, G_EDGE_LINE, B_EDGE_LINE };
+    mb->palettesize = 2;
+    return;
+  }
+  mb->palette[PAL_WALL] = (png_color) { R_WALL_LINE, G_WALL_LINE, B_WALL_LINE };
+  mb->palette[PAL_EDGE] = (png_color) { R_EDGE_LINE, G_EDGE_LINE, B_EDGE_LINE };
+  mb->palette[PAL_FG]   = (png_color) { R_FG, G_FG, B_FG };
+  mb->palette[PAL_BG]   = (png_color) { R_BG, G_BG, B_BG };
+  mb->palettesize = 4;
+} /* defaultpalette() */
+
+
+/* Turns the 8 bit RGB colors in cd into palette entries, reusing an
+ * entry for a repeated color, and swaps each color for its index.
+ */
+int
+setpalette(MAZEBITMAP *mb, COLORDATA *cd)
+{
+  int *color[8];
+  png_color pc;
+  int i, n, size;
+
+  if((!mb) || (!cd) || (mb->colortype != COLOR_PALETTE)) { return -1; }
+
+  color[0] = cd->wall;
+  color[1] = cd->edge;
+  color[2] = cd->fg;
+  color[3] = cd->bg;
+  color[4] = cd->uc1;
+  color[5] = cd->uc2;
+  color[6] = cd->uc3;
+  color[7] = cd->uc4;
+
+  size = 0;
+  for(i = 0; i < 8; i ++) {
+    pc.red   = color[i][0];
+    pc.green = color[i][1];
+    pc.blue  = color[i][2];
+    for(n = 0; n < size; n ++) {
+      if((mb->palette[n].red   == pc.red) &&
+         (mb->palette[n].green == pc.green) &&
+         (mb->palette[n].blue  == pc.blue)) {
+	break;
+      }
+    }
+    if(n == size) {
+      if(size == (1 << mb->colordepth)) { return -1; }
+      mb->palette[size ++] = pc;
+    }
+    color[i][0] = n;
+    color[i][1] = color[i][2] = color[i][3] = 0;
+  }
+
+  mb->palettesize = size;
+  cd->channels = 1;
+  cd->depth = mb->colordepth;
+  return size;
+} /* setpalette() */
+
+
 /* Takes a height and width, a color type, a color depth, and a
  * flag CELL_SIZE or MAZE_SIZE to interpret the height and width,
- * then allocates the memory for the image.
+ * and sets up the sizes, but does not allocate the image.
  * Returns a negative number on failure.
  * Returns 1 on "all good".
  * Returns 0 if bitmap options incompatible with PNG. (Still okay for PNM.)
  */
 int
-initmazebitmap(MAZEBITMAP *mb, int h, int w, int ct, int cd, int cellormaze)
+setupmazebitmap(MAZEBITMAP *mb, int h, int w, int ct, int cd, int cellormaze)
 {
   int  sampleround;
 
@@ -91,7 +168,8 @@ initmazebitmap(MAZEBITMAP *mb, int h, int w, int ct, int cd, int cellormaze)
     case COLOR_G:
     case COLOR_GA:
     case COLOR_RGB:
-    case COLOR_RGBA: mb->colortype = ct;
+    case COLOR_RGBA:
+    case COLOR_PALETTE: mb->colortype = ct;
                      break;
 
     default:         return -3;
@@ -106,12 +184,16 @@ initmazebitmap(MAZEBITMAP *mb, int h, int w, int ct, int cd, int cellormaze)
 
     default: return -4;
   } /* checking color depth */
+  if((ct == COLOR_PALETTE) && (cd > 8)) { return -4; }
 
   switch (ct) {
     case COLOR_G:    mb->channels = 1; break;
     case COLOR_GA:   mb->channels = 2; break;
     case COLOR_RGB:  mb->channels = 3; break;
     case COLOR_RGBA: mb->channels = 4; break;
+    case COLOR_PALETTE: mb->channels = 1;
+                     defaultpalette(mb);
+		     break;
   } /* set sample size */
 
   mb->cellsize = mb->cell_h * mb->cell_w * mb->channels;
@@ -132,6 +214,28 @@ initmazebitmap(MAZEBITMAP *mb, int h, int w, int ct, int cd, int cellormaze)
 
   mb->rowsize = (mb->img_w * mb->channels * cd) / 8 + sampleround;
 
+  if( (cd < 8) && (ct != COLOR_G) && (ct != COLOR_PALETTE) ) {
+    return 0;
+  }
+  return 1;
+} /* setupmazebitmap() */
+
+
+/* Takes a height and width, a color type, a color depth, and a
+ * flag CELL_SIZE or MAZE_SIZE to interpret the height and width,
+ * then allocates the memory for the image.
+ * Returns a negative number on failure.
+ * Returns 1 on "all good".
+ * Returns 0 if bitmap options incompatible with PNG. (Still okay for PNM.)
+ */
+int
+initmazebitmap(MAZEBITMAP *mb, int h, int w, int ct, int cd, int cellormaze)
+{
+  int rc;
+
+  rc = setupmazebitmap(mb, h, w, ct, cd, cellormaze);
+  if(rc < 0) { return rc; }
+
   mb->rowsp = (png_bytep *)malloc( mb->img_h * sizeof(png_bytep) );
   if(!mb->rowsp) {
     return -5;
@@ -151,10 +255,7 @@ initmazebitmap(MAZEBITMAP *mb, int h, int w, int ct, int cd, int cellormaze)
     } /* if allocation failed */
   } /* for each row */
 
-  if( (cd < 8) && (ct != COLOR_G) ) {
-    return 0;
-  }
-  return 1;
+  return rc;
 } /* initmazebitmap() */
 
 
@@ -225,13 +326,33 @@ draw_a_line(png_byte *image, int r1, int c1,
 } /* draw_a_line() */
 
 
+/* The percentage default_colorpicker() scales the background by, or -1
+ * if the background is not scaled for this depth, channels, and map.
+ */
+static int
+bgpercent(MAZEBITMAP *mb, CELL *c, int depth, int channels)
+{
+  int adjust;
+
+  if((depth > 7) && (channels > 2) && 
+      mb && mb->dmap && (mb->dmap->farthest > 3)) {
+
+    adjust = mb->dmap->map[c->id];
+    if (adjust < 2) { adjust = 2; } /* threshold minimum */
+    adjust = adjust * 100;
+    return (adjust / mb->dmap->farthest);
+  }
+  return -1;
+} /* bgpercent() */
+
+
 /* if colorfunc is undefined when default_drawcell is used to draw a maze,
  * this colorpicker routine kicks in.
  */
 void
 default_colorpicker(MAZEBITMAP *mb, CELL *c, COLORDATA *cd)
 {
-  int i, percent, adjust;
+  int i, percent;
 
   if(mb) {
     cd->channels = mb->channels;
@@ -239,7 +360,22 @@ default_colorpicker(MAZEBITMAP *mb, CELL *c, COLORDATA *cd)
   }
 
   /* We're lazy and always put in the alpha, so test gray or not gray */
-  if ( cd->channels < 3 ) {
+  if ( mb && (mb->colortype == COLOR_PALETTE) ) {
+    /* palette indices, and the background doesn't vary by distance */
+    if(mb->colordepth == 1) {
+      cd->wall[0] = cd->edge[0] = cd->fg[0] = PAL1_LINE;
+      cd->bg[0]   = PAL1_BG;
+    } else {
+      cd->wall[0] = PAL_WALL;
+      cd->edge[0] = PAL_EDGE;
+      cd->fg[0]   = PAL_FG;
+      cd->bg[0]   = PAL_BG;
+    }
+    for(i = 1; i < 4; i++) {
+      cd->wall[i] = cd->edge[i] = cd->fg[i] = cd->bg[i] = 0;
+    }
+    return;
+  } else if ( cd->channels < 3 ) {
     cd->wall[0] = GRAY_WALL_LINE;
     cd->edge[0] = GRAY_EDGE_LINE;
     cd->fg[0]   = GRAY_FG;
@@ -282,14 +418,8 @@ default_colorpicker(MAZEBITMAP *mb, CELL *c, COLORDATA *cd)
    * map and that map has non-trivial distances, then adjust background
    * color by distance.
    */
-  if((cd->depth > 7) && (cd->channels > 2) && 
-      mb && mb->dmap && (mb->dmap->farthest > 3)) {
-
-    adjust = mb->dmap->map[c->id];
-    if (adjust < 2) { adjust = 2; } /* threshold minimum */
-    adjust = adjust * 100;
-    percent = (adjust / mb->dmap->farthest);
-
+  percent = bgpercent(mb, c, cd->depth, cd->channels);
+  if(percent >= 0) {
     for(i = 0; i < 4; i++) {
       cd->bg[i]   = (cd->bg[i] * percent) / 100;
     }
@@ -374,6 +504,22 @@ default_drawcell(MAZEBITMAP *mb, png_byte *image, CELL *c)
 } /* default_drawcell */
 
 
+/* The tile cache key for default_drawcell(): walls, edges, and the
+ * distance shading of the background (which has at most 101 steps).
+ */
+int
+default_cellkey(MAZEBITMAP *mb, CELL *c)
+{
+  int key;
+
+  /* mask off NO_WALLS and NO_EDGES, those are implied by zero */
+  key  = wallstatusbycell(c) & 0xf;
+  key |= (edgestatusbycell(mb->dmap->grid, c) & 0xf) << 4;
+  key |= (bgpercent(mb, c, mb->colordepth, mb->channels) + 1) << 8;
+  return key;
+} /* default_cellkey() */
+
+
 /* can place a cell image (or any other rectangle) onto the full
  * size image. This is divorced from the overall maze bitmap structure
  * just so it can be used for putting any rectangle into the image,
@@ -580,23 +726,244 @@ drawandplacecell(GRID *g,CELL *cell,MAZEBITMAP *mb)
 } /* drawandplacecell() */
 
 
+/* one rendered tile and the cellfunc() return value it came with */
+typedef struct tile_s {
+  int rc;
+  png_byte *image;
+} TILE;
+
+/* What a band drawer needs: the cellkey to use (if any), the tile cache
+ * for those keys, and a scratch cell image for uncached cells.
+ */
+typedef struct tileset_s {
+  CELLKEY_P keyfunc;
+  TILE *tiles;
+  png_byte *scratch;
+} TILESET;
+
+
+/* Supplies the default cellfunc if needed and picks the cellkey to
+ * use with it: the user's, default_cellkey() for the default cellfunc,
+ * or NULL for no tile cache.
+ */
+static CELLKEY_P
+pickkeyfunc(MAZEBITMAP *mb)
+{
+  if(!mb->cellfunc) {
+    mb->cellfunc = (CELLFUNC_P) default_drawcell;
+  }
+  if(mb->cellkey) {
+    return mb->cellkey;
+  }
+  if(mb->cellfunc == (CELLFUNC_P) default_drawcell) {
+    return (CELLKEY_P) default_cellkey;
+  }
+  return NULL;
+} /* pickkeyfunc() */
+
+
+/* returns 0, or -100 on memory error */
+static int
+tilesetup(TILESET *ts, MAZEBITMAP *mb, CELLKEY_P keyfunc)
+{
+  ts->keyfunc = keyfunc;
+  ts->tiles = NULL;
+  ts->scratch = (png_byte *)malloc( (size_t)mb->cellsize );
+  if(!ts->scratch) { return -100; }
+
+  if(keyfunc) {
+    ts->tiles = (TILE *)calloc( (size_t)TILE_KEYS, sizeof(TILE) );
+    if(!ts->tiles) {
+      free(ts->scratch);
+      return -100;
+    }
+  }
+  return 0;
+} /* tilesetup() */
+
+
+static void
+tilefree(TILESET *ts)
+{
+  if(ts->tiles) {
+    for(int key = 0; key < TILE_KEYS; key ++) {
+      free(ts->tiles[key].image);
+    }
+    free(ts->tiles);
+  }
+  free(ts->scratch);
+} /* tilefree() */
+
+
+/* Draws maze row i into rows, starting at pixel row top. With a tile
+ * cache, cellfunc() is called for the first cell with each key, later
+ * cells with that key get a copy of the same tile. Cells with a negative
+ * (or too large) key are drawn fresh every time. Cells are placed left
+ * to right, which placerectangle() relies on at depths under 8. Returns
+ * the sum of cellfunc() return values, cells with negative values are
+ * not placed.
+ */
+static int
+drawband(MAZEBITMAP *mb, TILESET *ts, int i, png_bytep *rows, int top)
+{
+  GRID *g = mb->dmap->grid;
+  TILE *t;
+  CELL *cell;
+  png_byte *image;
+  int j, key, cellrc, rc = 0;
+
+  for(j = 0; j < g->cols; j ++) {
+    cell = visitrc(g, i, j);
+    key = -1;
+    if(ts->keyfunc) {
+      key = ts->keyfunc(mb, cell);
+    }
+
+    if((key < 0) || (key >= TILE_KEYS)) {
+      image = ts->scratch;
+      memset(image, 0, mb->cellsize);
+      cellrc = (mb->cellfunc)(mb, image, cell);
+    } else {
+      t = &(ts->tiles[key]);
+      if(!t->image) {
+	t->image = calloc( (size_t)1, (size_t)mb->cellsize );
+	if(!t->image) { rc += -100; continue; }
+
+	t->rc = (mb->cellfunc)(mb, t->image, cell);
+	if(t->rc < 0) {
+	  /* not cached, so the next cell with this key tries again */
+	  rc += t->rc;
+	  free(t->image);
+	  t->image = NULL;
+	  continue;
+	}
+      }
+      image = t->image;
+      cellrc = t->rc;
+    }
+
+    rc += cellrc;
+    if(cellrc < 0) { continue; }
+
+    placerectangle(image, mb->cell_w, mb->cell_h, rows,
+                       top, j * mb->cell_w,
+                       mb->colordepth, mb->channels);
+  }
+
+  return rc;
+} /* drawband() */
+
+
 /* Draws a maze into the maze bitmap. If the cellfunc is not defined,
- * supplies a default. Then iterates the drawandplacecell() function.
+ * supplies a default. If there is a cellkey (or the default cellfunc
+ * is in use) draws through the tile cache, otherwise iterates the
+ * drawandplacecell() function.
  */
 int
 drawmaze(MAZEBITMAP *mb)
 {
   int rc;
+  TILESET ts;
+  CELLKEY_P keyfunc;
+
   if(!mb)    { return -1; }
 
-  if(!mb->cellfunc) {
-    mb->cellfunc = (CELLFUNC_P) default_drawcell;
+  keyfunc = pickkeyfunc(mb);
+  if(!keyfunc) {
+    rc = iterategrid( mb->dmap->grid, (IFUNC_P) drawandplacecell, mb);
+    return rc;
+  }
+
+  if(tilesetup(&ts, mb, keyfunc)) { return -100; }
+  rc = 0;
+  for(int i = 0; i < mb->rows; i ++) {
+    rc += drawband(mb, &ts, i, mb->rowsp, i * mb->cell_h);
   }
-  rc = iterategrid( mb->dmap->grid, (IFUNC_P) drawandplacecell, mb);
+  tilefree(&ts);
   return rc;
 } /* drawmaze */
 
 
+/* Rows of cells handed to each pdrawmaze() thread at a time. */
+#define PDRAW_CHUNK	8
+
+typedef struct pdraw_s {
+  MAZEBITMAP *mb;
+  CELLKEY_P keyfunc;
+  int nextrow;		/* next maze row not yet handed out */
+  int rc;		/* sum of drawband() results */
+} PDRAW;
+
+/* pthread worker for pdrawmaze(), draws chunks of rows until none are
+ * left. Each worker has its own scratch cell and tile cache.
+ */
+static void *
+pdrawworker(void *arg)
+{
+  PDRAW *pd = (PDRAW *)arg;
+  MAZEBITMAP *mb = pd->mb;
+  TILESET ts;
+  int row, last, rc = 0;
+
+  if(tilesetup(&ts, mb, pd->keyfunc)) {
+    /* the other threads will take this one's share */
+    __atomic_fetch_add(&pd->rc, -100, __ATOMIC_RELAXED);
+    return NULL;
+  }
+
+  while(1) {
+    row = __atomic_fetch_add(&pd->nextrow, PDRAW_CHUNK, __ATOMIC_RELAXED);
+    if(row >= mb->rows) { break; }
+    last = row + PDRAW_CHUNK;
+    if(last > mb->rows) { last = mb->rows; }
+
+    for( ; row < last; row ++) {
+      rc += drawband(mb, &ts, row, mb->rowsp, row * mb->cell_h);
+    }
+  }
+
+  tilefree(&ts);
+  __atomic_fetch_add(&pd->rc, rc, __ATOMIC_RELAXED);
+  return NULL;
+} /* pdrawworker() */
+
+/* Each row of cells covers its own cell_h rows of the image, even the
+ * bit packing at depths under 8 never crosses a pixel row, so rows of
+ * cells can be drawn in parallel with no locking.
+ */
+int
+pdrawmaze(MAZEBITMAP *mb, int threads)
+{
+  PDRAW pd;
+  pthread_t *tids;
+  int started;
+
+  if(!mb)    { return -1; }
+  if(threads < 1) { threads = 1; }
+
+  tids = (pthread_t *)malloc( threads * sizeof(pthread_t) );
+  if(!tids) { return -100; }
+
+  pd.mb = mb;
+  pd.keyfunc = pickkeyfunc(mb);
+  pd.nextrow = 0;
+  pd.rc = 0;
+
+  for(started = 1; started < threads; started ++) {
+    if(pthread_create(&tids[started], NULL, pdrawworker, &pd)) {
+      break;
+    }
+  }
+  pdrawworker(&pd);
+  for(int t = 1; t < started; t ++) {
+    pthread_join(tids[t], NULL);
+  }
+  free(tids);
+
+  return pd.rc;
+} /* pdrawmaze() */
+
+
 /* PNM is a family of easy to read / write file formats that are terrible
  * long term use, but good for easy file interchange between programs.
  * The "N" stans for "aNy".
@@ -705,6 +1072,28 @@ writepnm(MAZEBITMAP *mb, char *filename)
   /* It would cool and all if I ever checked return values from fprintf
    * or putc. Consider it a TODO for "disk full" type scenarios.
    */
+  if(mb->colortype == COLOR_PALETTE) {
+    /* PNM has no palettes, so look up each pixel for a PPM */
+    png_color *pc;
+    int shift;
+
+    fprintf(fp, "P6\n%d %d\n255\n", mb->img_w, mb->img_h);
+    for(i = 0; i < mb->img_h; i++) {
+      row = mb->rowsp[i];
+      for(j = 0; j < mb->img_w; j++) {
+        k = j * mb->colordepth;
+	shift = 8 - mb->colordepth - (k % 8);
+        sample = (row[k / 8] >> shift) & (maxval);
+	pc = &(mb->palette[sample]);
+	putc(pc->red, fp);
+	putc(pc->green, fp);
+	putc(pc->blue, fp);
+      }
+    }
+    fclose(fp);
+    return 0;
+  }
+
   if(mb->channels == 2) {
     /* PAM grayscale */
     fprintf(fp, "P7\n" );
@@ -808,8 +1197,30 @@ writepnm(MAZEBITMAP *mb, char *filename)
 } /* writepnm() */
 
 
+/* Passes the palette, if any, and the zlevel and filter settings, if
+ * not defaults, to libpng.
+ */
+static void
+pngoptions(png_structp png_ptr, png_infop info_ptr, MAZEBITMAP *mb)
+{
+  static const int mask[] = { PNG_FILTER_NONE, PNG_FILTER_SUB,
+  				PNG_FILTER_UP, PNG_FILTER_AVG,
+				PNG_FILTER_PAETH, PNG_ALL_FILTERS };
+
+  if(mb->colortype == COLOR_PALETTE) {
+    png_set_PLTE(png_ptr, info_ptr, mb->palette, mb->palettesize);
+  }
+  if(mb->zlevel != ZLEVEL_DEFAULT) {
+    png_set_compression_level(png_ptr, mb->zlevel);
+  }
+  if((mb->filter >= FILTER_NONE) && (mb->filter <= FILTER_ADAPTIVE)) {
+    png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, mask[mb->filter]);
+  }
+} /* pngoptions() */
+
+
 /* Write a PNG version of a maze bitmap.
- * This is (currently) the only function that actually uses libpng
+ * This and streampng() are the only functions that actually use libpng
  * functions (as opposed to libpng #defines and data types).
  * returns a 0 on success, or a negative value on failure.
  */
@@ -820,6 +1231,9 @@ writepng(MAZEBITMAP *mb, char *filename)
   png_infop info_ptr;
 
   if(!mb) { return -1; }
+  if((mb->zlevel < ZLEVEL_DEFAULT) || (mb->zlevel > ZLEVEL_MAX)) {
+    return ZLEVEL_ERROR;
+  }
 
   FILE *fp = fopen(filename, "w");
   if(!fp) {
@@ -859,6 +1273,7 @@ writepng(MAZEBITMAP *mb, char *filename)
                mb->colordepth, mb->colortype, 
 	       PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE,
 	       PNG_FILTER_TYPE_BASE);
+  pngoptions(png_ptr, info_ptr, mb);
   png_write_info(png_ptr, info_ptr);
 
   if (setjmp(png_jmpbuf(png_ptr))) {
@@ -879,3 +1294,522 @@ writepng(MAZEBITMAP *mb, char *filename)
   return 0;
 } /* writepng() */
 
+
+
+/* The libpng part of streampng(), writes to an open file using an
+ * allocated band and TILESET. Returns the sum of cellfunc() return
+ * values or a negative value on failure.
+ */
+static int
+streamrows(MAZEBITMAP *mb, TILESET *ts, png_bytep *band, FILE *fp)
+{
+  png_structp png_ptr;
+  png_infop info_ptr;
+  size_t bandsize = (size_t)mb->cell_h * mb->rowsize;
+  volatile int rc = 0;	/* changed after setjmp(), so not in a register */
+  int i, k;
+
+  png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if(!png_ptr) {
+    fprintf(stderr, "create png write struct failed\n");
+    return -2;
+  }
+
+  info_ptr = png_create_info_struct(png_ptr);
+  if(!info_ptr) {
+    fprintf(stderr, "create png info struct failed\n");
+    png_destroy_write_struct(&png_ptr, NULL);
+    return -2;
+  }
+
+  /* see writepng() on setjmp(), one jump point covers all of it here */
+  if (setjmp(png_jmpbuf(png_ptr))) {
+    fprintf(stderr, "streaming png failed\n");
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    return -3;
+  }
+  png_init_io(png_ptr, fp);
+
+  png_set_IHDR(png_ptr, info_ptr, mb->img_w, mb->img_h,
+               mb->colordepth, mb->colortype, 
+	       PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE,
+	       PNG_FILTER_TYPE_BASE);
+  pngoptions(png_ptr, info_ptr, mb);
+  png_write_info(png_ptr, info_ptr);
+
+  for(i = 0; i < mb->rows; i ++) {
+    /* cleared each time for cells that don't get placed */
+    memset(band[0], 0, bandsize);
+    rc += drawband(mb, ts, i, band, 0);
+    for(k = 0; k < mb->cell_h; k ++) {
+      png_write_row(png_ptr, band[k]);
+    }
+  }
+
+  /* MAZE_SIZE can leave a few blank rows past the last cell */
+  memset(band[0], 0, mb->rowsize);
+  for(k = mb->rows * mb->cell_h; k < mb->img_h; k ++) {
+    png_write_row(png_ptr, band[0]);
+  }
+
+  png_write_end(png_ptr, NULL);
+  png_destroy_write_struct(&png_ptr, &info_ptr);
+  return rc;
+} /* streamrows() */
+
+
+/* Draws a maze and writes it as a PNG one band of cell_h pixel rows at a
+ * time, so only a band (not the whole image) is ever in memory. The
+ * MAZEBITMAP needs only setupmazebitmap(), rowsp is not used. Makes the
+ * same file drawmaze() then writepng() would.
+ * Returns the sum of cellfunc() return values like drawmaze(), or a
+ * negative value on memory or file failure.
+ */
+int
+streampng(MAZEBITMAP *mb, char *filename)
+{
+  png_bytep *band;
+  png_byte *block;
+  TILESET ts;
+  FILE *fp;
+  int k, rc;
+
+  if((!mb) || (!mb->dmap) || (mb->cellsize < 1)) { return -1; }
+  if((mb->zlevel < ZLEVEL_DEFAULT) || (mb->zlevel > ZLEVEL_MAX)) {
+    return ZLEVEL_ERROR;
+  }
+
+  /* one block for the band, so it can be cleared in one go */
+  band  = (png_bytep *)malloc( mb->cell_h * sizeof(png_bytep) );
+  block = (png_byte *)malloc( (size_t)mb->cell_h * mb->rowsize );
+  if((!band) || (!block)) {
+    free(band);
+    free(block);
+    return -100;
+  }
+  for(k = 0; k < mb->cell_h; k ++) {
+    band[k] = &(block[k * mb->rowsize]);
+  }
+
+  if(tilesetup(&ts, mb, pickkeyfunc(mb))) {
+    free(band);
+    free(block);
+    return -100;
+  }
+
+  fp = fopen(filename, "w");
+  if(fp) {
+    rc = streamrows(mb, &ts, band, fp);
+    fclose(fp);
+  } else {
+    fprintf(stderr, "failed to open %s\n", filename);
+    rc = -1;
+  }
+
+  tilefree(&ts);
+  free(band);
+  free(block);
+  return rc;
+} /* streampng() */
+
+
+/* Uncompressed bytes in each piece pwritepng() deflates on its own. */
+#define PZ_CHUNK	(128 * 1024)
+/* deflate window, and so the most dictionary a piece can use */
+#define PZ_WINDOW	(32 * 1024)
+
+/* one piece of the zlib stream */
+typedef struct pzchunk_s {
+  unsigned char *out;	/* raw deflate data (plus room for the zlib bits) */
+  size_t outlen;
+  uLong adler;		/* adler32 of this piece's uncompressed data */
+  uLong inlen;
+  int rc;
+} PZCHUNK;
+
+typedef struct pzip_s {
+  MAZEBITMAP *mb;
+  int rowbytes;		/* bytes per PNG row, not counting the filter byte */
+  int bpp;		/* bytes per pixel, rounded up, for filtering */
+  int filter;
+  int chunkrows;	/* image rows per piece */
+  int dictrows;		/* rows before a piece needed for its dictionary */
+  int chunks;
+  int nextchunk;	/* next piece not yet handed out */
+  PZCHUNK *chunk;
+} PZIP;
+
+
+/* PNG's Paeth predictor, rearranged the way libpng does it: with
+ * p = a + b - c, p - a is b - c and p - b is a - c.
+ */
+static inline int
+paeth(int a, int b, int c)
+{
+  int pa = b - c;
+  int pb = a - c;
+  int pc = pa + pb;
+
+  if(pa < 0) { pa = -pa; }
+  if(pb < 0) { pb = -pb; }
+  if(pc < 0) { pc = -pc; }
+
+  if((pa <= pb) && (pa <= pc)) { return a; }
+  if(pb <= pc) { return b; }
+  return c;
+} /* paeth() */
+
+
+/* Applies one PNG filter to raw, with the row above in prev (NULL for
+ * the first row), writing rowbytes into out.
+ */
+static void
+filterrow(int type, png_byte *raw, png_byte *prev, int rowbytes, int bpp,
+	  png_byte *out)
+{
+  int i;
+
+  if(!prev) {
+    /* the row above the image is all zeros */
+    switch(type) {
+      case FILTER_UP:    type = FILTER_NONE; break;
+      case FILTER_PAETH: type = FILTER_SUB;  break;
+      case FILTER_AVG:
+	for(i = 0; i < bpp; i ++)        { out[i] = raw[i]; }
+	for(     ; i < rowbytes; i ++)   { out[i] = raw[i] - (raw[i-bpp] >> 1); }
+	return;
+    }
+  }
+
+  switch(type) {
+    case FILTER_SUB:
+      for(i = 0; i < bpp; i ++)          { out[i] = raw[i]; }
+      for(     ; i < rowbytes; i ++)     { out[i] = raw[i] - raw[i-bpp]; }
+      break;
+    case FILTER_UP:
+      for(i = 0; i < rowbytes; i ++)     { out[i] = raw[i] - prev[i]; }
+      break;
+    case FILTER_AVG:
+      for(i = 0; i < bpp; i ++)          { out[i] = raw[i] - (prev[i] >> 1); }
+      for(     ; i < rowbytes; i ++) {
+	out[i] = raw[i] - ((raw[i-bpp] + prev[i]) >> 1);
+      }
+      break;
+    case FILTER_PAETH:
+      for(i = 0; i < bpp; i ++)          { out[i] = raw[i] - prev[i]; }
+      for(     ; i < rowbytes; i ++) {
+	out[i] = raw[i] - paeth(raw[i-bpp], prev[i], prev[i-bpp]);
+      }
+      break;
+    default:
+      memcpy(out, raw, rowbytes);
+      break;
+  }
+} /* filterrow() */
+
+
+/* libpng's "minimum sum of absolute differences" score for picking an
+ * adaptive filter, giving up once past limit.
+ */
+static int
+rowscore(png_byte *out, int rowbytes, int limit)
+{
+  int i, score = 0;
+
+  for(i = 0; (i < rowbytes) && (score < limit); i ++) {
+    score += abs((signed char)out[i]);
+  }
+  return score;
+} /* rowscore() */
+
+
+/* Filters image rows first to last - 1 into out, each row being a filter
+ * type byte and rowbytes of filtered data. tmp needs rowbytes of space.
+ */
+static void
+filterrows(PZIP *pz, int first, int last, png_byte *out, png_byte *tmp)
+{
+  png_bytep *rows = pz->mb->rowsp;
+  png_byte *prev;
+  int r, type, score, best;
+
+  for(r = first; r < last; r ++) {
+    prev = (r > 0)? rows[r - 1]: NULL;
+
+    if(pz->filter == FILTER_ADAPTIVE) {
+      out[0] = FILTER_NONE;
+      filterrow(FILTER_NONE, rows[r], prev, pz->rowbytes, pz->bpp, &(out[1]));
+      best = rowscore(&(out[1]), pz->rowbytes, INT_MAX);
+      for(type = FILTER_SUB; type <= FILTER_PAETH; type ++) {
+        filterrow(type, rows[r], prev, pz->rowbytes, pz->bpp, tmp);
+	score = rowscore(tmp, pz->rowbytes, best);
+	if(score < best) {
+	  best = score;
+	  out[0] = type;
+	  memcpy(&(out[1]), tmp, pz->rowbytes);
+	}
+      }
+    } else {
+      out[0] = pz->filter;
+      filterrow(pz->filter, rows[r], prev, pz->rowbytes, pz->bpp, &(out[1]));
+    }
+    out += pz->rowbytes + 1;
+  }
+} /* filterrows() */
+
+
+/* Filters and deflates piece c. Every piece but the last ends with a
+ * sync flush so the raw deflate data can be joined end to end. The
+ * end of the previous piece is used as a dictionary, which is how pigz
+ * keeps the compression close to single threaded. The first piece
+ * leaves room for the two byte zlib header, the last for the adler32.
+ */
+static void
+pzchunk(PZIP *pz, int c)
+{
+  PZCHUNK *pc = &(pz->chunk[c]);
+  MAZEBITMAP *mb = pz->mb;
+  z_stream zs;
+  png_byte *buf, *tmp, *in;
+  size_t line = pz->rowbytes + 1;
+  size_t size, dictlen, start;
+  int first, last, dictfirst, zrc;
+
+  first = c * pz->chunkrows;
+  last = first + pz->chunkrows;
+  if(last > mb->img_h) { last = mb->img_h; }
+  dictfirst = first - pz->dictrows;
+  if(dictfirst < 0) { dictfirst = 0; }
+
+  buf = (png_byte *)malloc( (last - dictfirst) * line );
+  tmp = (png_byte *)malloc( line );
+  if(!buf || !tmp) {
+    free(buf);
+    free(tmp);
+    pc->rc = -100;
+    return;
+  }
+  filterrows(pz, dictfirst, last, buf, tmp);
+  free(tmp);
+
+  in = &(buf[(first - dictfirst) * line]);
+  pc->inlen = (last - first) * line;
+  pc->adler = adler32(adler32(0L, Z_NULL, 0), in, pc->inlen);
+
+  /* libpng also uses Z_FILTERED for filtered rows */
+  memset(&zs, 0, sizeof(zs));
+  if(deflateInit2(&zs, mb->zlevel, Z_DEFLATED, -15, 8,
+  	(pz->filter == FILTER_NONE)? Z_DEFAULT_STRATEGY: Z_FILTERED) != Z_OK) {
+    free(buf);
+    pc->rc = -100;
+    return;
+  }
+  dictlen = (first - dictfirst) * line;
+  if(dictlen > PZ_WINDOW) { dictlen = PZ_WINDOW; }
+  if(dictlen) {
+    deflateSetDictionary(&zs, in - dictlen, dictlen);
+  }
+
+  /* room for the zlib header, a sync flush, and the adler32 */
+  start = (c == 0)? 2: 0;
+  size = start + deflateBound(&zs, pc->inlen) + 16;
+  pc->out = (unsigned char *)malloc( size );
+  if(!pc->out) {
+    deflateEnd(&zs);
+    free(buf);
+    pc->rc = -100;
+    return;
+  }
+
+  zs.next_in   = in;
+  zs.avail_in  = pc->inlen;
+  zs.next_out  = &(pc->out[start]);
+  zs.avail_out = size - start - 4;
+  zrc = deflate(&zs, (c == pz->chunks - 1)? Z_FINISH: Z_SYNC_FLUSH);
+  if((zs.avail_in != 0) || (zs.avail_out == 0) ||
+     ((zrc != Z_OK) && (zrc != Z_STREAM_END))) {
+    /* deflateBound() says this doesn't happen */
+    pc->rc = -6;
+  } else {
+    pc->outlen = start + (size - start - 4 - zs.avail_out);
+    pc->rc = 0;
+  }
+
+  deflateEnd(&zs);
+  free(buf);
+} /* pzchunk() */
+
+
+/* pthread worker for pwritepng(), deflates pieces until none are left */
+static void *
+pzworker(void *arg)
+{
+  PZIP *pz = (PZIP *)arg;
+  int c;
+
+  while(1) {
+    c = __atomic_fetch_add(&pz->nextchunk, 1, __ATOMIC_RELAXED);
+    if(c >= pz->chunks) { break; }
+    pzchunk(pz, c);
+  }
+  return NULL;
+} /* pzworker() */
+
+
+/* writes a big endian 32 bit number */
+static void
+putuint32(unsigned char *p, uLong n)
+{
+  p[0] = (n >> 24) & 0xff;
+  p[1] = (n >> 16) & 0xff;
+  p[2] = (n >>  8) & 0xff;
+  p[3] =  n        & 0xff;
+} /* putuint32() */
+
+
+/* writes a PNG chunk: length, type, data, CRC of type and data */
+static int
+pngchunk(FILE *fp, const char *type, unsigned char *data, size_t len)
+{
+  unsigned char word[4];
+  uLong crc;
+
+  crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, (const Bytef *)type, 4);
+  if(len) { crc = crc32(crc, data, len); }
+
+  putuint32(word, len);
+  if(fwrite(word, 4, 1, fp) != 1) { return -1; }
+  if(fwrite(type, 4, 1, fp) != 1) { return -1; }
+  if(len && (fwrite(data, len, 1, fp) != 1)) { return -1; }
+  putuint32(word, crc);
+  if(fwrite(word, 4, 1, fp) != 1) { return -1; }
+  return 0;
+} /* pngchunk() */
+
+
+/* Each piece is filtered and deflated by whichever thread picks it up,
+ * then the pieces are written in order, one IDAT chunk each, by the
+ * calling thread. The zlib header goes on the front of the first piece
+ * and the adler32 of the whole (combined from the pieces) on the end of
+ * the last. Only IHDR, IDAT, and IEND are written, as with writepng().
+ */
+int
+pwritepng(MAZEBITMAP *mb, char *filename, int threads)
+{
+  static const unsigned char signature[8] = { 137, 'P', 'N', 'G',
+  						'\r', '\n', 26, '\n' };
+  unsigned char ihdr[13];
+  PZIP pz;
+  PZCHUNK *pc;
+  pthread_t *tids;
+  uLong adler;
+  int c, flg, started, rc = 0;
+  FILE *fp;
+
+  if((!mb) || (!mb->rowsp) || (mb->img_h < 1)) { return -1; }
+  if((mb->zlevel < ZLEVEL_DEFAULT) || (mb->zlevel > ZLEVEL_MAX)) {
+    return ZLEVEL_ERROR;
+  }
+  if(threads < 1) { threads = 1; }
+
+  pz.mb = mb;
+  pz.rowbytes = (mb->img_w * mb->channels * mb->colordepth + 7) / 8;
+  pz.bpp = (mb->channels * mb->colordepth + 7) / 8;
+  pz.filter = mb->filter;
+  if((pz.filter < FILTER_NONE) || (pz.filter > FILTER_ADAPTIVE)) {
+    /* what libpng does: adaptive, except none for palettes or under 8 bits */
+    if((mb->colordepth < 8) || (mb->colortype == COLOR_PALETTE)) {
+      pz.filter = FILTER_NONE;
+    } else {
+      pz.filter = FILTER_ADAPTIVE;
+    }
+  }
+  pz.chunkrows = PZ_CHUNK / (pz.rowbytes + 1);
+  if(pz.chunkrows < 1) { pz.chunkrows = 1; }
+  pz.dictrows = (PZ_WINDOW + pz.rowbytes) / (pz.rowbytes + 1);
+  pz.chunks = (mb->img_h + pz.chunkrows - 1) / pz.chunkrows;
+  pz.nextchunk = 0;
+
+  pz.chunk = (PZCHUNK *)calloc( pz.chunks, sizeof(PZCHUNK) );
+  tids = (pthread_t *)malloc( threads * sizeof(pthread_t) );
+  if(!pz.chunk || !tids) {
+    free(pz.chunk);
+    free(tids);
+    return -100;
+  }
+
+  for(started = 1; started < threads; started ++) {
+    if(pthread_create(&tids[started], NULL, pzworker, &pz)) {
+      break;
+    }
+  }
+  pzworker(&pz);
+  for(int t = 1; t < started; t ++) {
+    pthread_join(tids[t], NULL);
+  }
+  free(tids);
+
+  adler = adler32(0L, Z_NULL, 0);
+  for(c = 0; c < pz.chunks; c ++) {
+    pc = &(pz.chunk[c]);
+    if(pc->rc < 0) { rc = pc->rc; }
+    adler = adler32_combine(adler, pc->adler, pc->inlen);
+  }
+
+  if(rc == 0) {
+    /* deflate, 32k window; FLEVEL is only a hint, but set it as zlib would */
+    pc = &(pz.chunk[0]);
+    pc->out[0] = 0x78;
+    if((mb->zlevel == ZLEVEL_DEFAULT) || (mb->zlevel == 6)) { flg = 2; }
+    else if(mb->zlevel < 2) { flg = 0; }
+    else if(mb->zlevel < 6) { flg = 1; }
+    else                    { flg = 3; }
+    flg <<= 6;
+    flg += 31 - ((0x78 * 256 + flg) % 31);
+    pc->out[1] = flg;
+
+    pc = &(pz.chunk[pz.chunks - 1]);
+    putuint32(&(pc->out[pc->outlen]), adler);
+    pc->outlen += 4;
+
+    putuint32(&(ihdr[0]), mb->img_w);
+    putuint32(&(ihdr[4]), mb->img_h);
+    ihdr[8]  = mb->colordepth;
+    ihdr[9]  = mb->colortype;
+    ihdr[10] = PNG_COMPRESSION_TYPE_BASE;
+    ihdr[11] = PNG_FILTER_TYPE_BASE;
+    ihdr[12] = PNG_INTERLACE_NONE;
+
+    fp = fopen(filename, "w");
+    if(!fp) {
+      fprintf(stderr, "failed to open %s\n", filename);
+      rc = -1;
+    } else {
+      if((fwrite(signature, sizeof(signature), 1, fp) != 1) ||
+         pngchunk(fp, "IHDR", ihdr, sizeof(ihdr))) {
+	rc = -4;
+      }
+      if((rc == 0) && (mb->colortype == COLOR_PALETTE) &&
+         pngchunk(fp, "PLTE", (unsigned char *)mb->palette,
+	 		3 * mb->palettesize)) {
+	rc = -4;
+      }
+      for(c = 0; (rc == 0) && (c < pz.chunks); c ++) {
+        if(pngchunk(fp, "IDAT", pz.chunk[c].out, pz.chunk[c].outlen)) {
+	  rc = -5;
+	}
+      }
+      if((rc == 0) && pngchunk(fp, "IEND", NULL, 0)) {
+        rc = -6;
+      }
+      if(fclose(fp)) { rc = -6; }
+    }
+  }
+
+  for(c = 0; c < pz.chunks; c ++) {
+    free(pz.chunk[c].out);
+  }
+  free(pz.chunk);
+  return rc;
+} /* pwritepng() */
@@ -1,6 +1,6 @@
 /* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
 /* ways to make a maze grid into an image */
-/* uses libpng.h */
+/* uses libpng.h and zlib.h */
 
 #ifndef _MAZEIMG_H
 #define _MAZEIMG_H
@@ -40,10 +40,40 @@
 #define B_BG             0x00    /* 0xff8f00, an orange */
 
 
+/* cellkey values must be less than this to use the drawmaze() tile cache */
+#define TILE_KEYS	0x10000
+
+/* for the filter setting, the PNG row filter to use when writing */
+#define FILTER_DEFAULT	-1	/* let libpng choose (pwritepng() copies it) */
+#define FILTER_NONE	PNG_FILTER_VALUE_NONE
+#define FILTER_SUB	PNG_FILTER_VALUE_SUB
+#define FILTER_UP	PNG_FILTER_VALUE_UP
+#define FILTER_AVG	PNG_FILTER_VALUE_AVG
+#define FILTER_PAETH	PNG_FILTER_VALUE_PAETH
+#define FILTER_ADAPTIVE	PNG_FILTER_VALUE_LAST	/* best filter each row */
+
+/* for the zlevel setting, otherwise 0 (no compression) to 9 (best) */
+#define ZLEVEL_DEFAULT	-1
+#define ZLEVEL_MAX	9
+/* returned by the PNG writers for a zlevel out of that range */
+#define ZLEVEL_ERROR	-7
+
 #define COLOR_G 	PNG_COLOR_TYPE_GRAY
 #define COLOR_GA        PNG_COLOR_TYPE_GRAY_ALPHA
 #define COLOR_RGB       PNG_COLOR_TYPE_RGB
 #define COLOR_RGBA      PNG_COLOR_TYPE_RGB_ALPHA
+#define COLOR_PALETTE   PNG_COLOR_TYPE_PALETTE
+
+/* most palette entries, and the ones in the default palette; a 1 bit
+ * palette only has PAL1_BG and PAL1_LINE, lines being walls, edges and fg
+ */
+#define PALETTE_MAX	256
+#define PAL_WALL	0
+#define PAL_EDGE	1
+#define PAL_FG		2
+#define PAL_BG		3
+#define PAL1_BG		0
+#define PAL1_LINE	1
 
 /* Color structure used by default color picker.
  * Set channels and depth before calling the color picker,
@@ -69,7 +99,8 @@ typedef struct mazebitmap_s {
   int cell_w, cell_h;
   int img_w, img_h;
 
-  int colortype; /* COLOR_G, COLOR_GA, COLOR_RGB, COLOR_RGBA
+  int colortype; /* COLOR_G, COLOR_GA, COLOR_RGB, COLOR_RGBA,
+                  * COLOR_PALETTE
                   * The channels are listed in order expected,
 		  * eg, alpha channel always comes last
 		  */
@@ -80,6 +111,7 @@ typedef struct mazebitmap_s {
 		 * Gray with Alpha: only 8 or 16
 		 * RGB: only 8 or 16
 		 * RGB with Alpha: only 8 or 16
+		 * Palette: 1, 2, 4, or 8
 		 */
 
   int channels;  /* each of Red, Green, Blue, Gray and Alpha is a channel */
@@ -94,6 +126,12 @@ typedef struct mazebitmap_s {
 		 * Channels are in order suggested by name, eg RGB is
 		 * red, green, blue.
 		 */
+  /* For COLOR_PALETTE, the colors the pixel values index, starting as
+   * the default palette (see PAL_WALL, etc) and changed by setpalette().
+   */
+  png_color palette[PALETTE_MAX];
+  int palettesize;
+
   DMAP *dmap;
   png_bytep *rowsp;	/* A list of pointers to each row */
   			/* Each row is basically the raw data */
@@ -121,6 +159,23 @@ typedef struct mazebitmap_s {
    */
   void (*colorfunc)(struct mazebitmap_s *, CELL */*cell*/, COLORDATA *);
 
+  /* Optional tile cache key for cellfunc. Any two cells that cellfunc
+   * would draw identically should get the same key, from 0 up to
+   * TILE_KEYS - 1. drawmaze() then calls cellfunc once per key and copies
+   * that tile for every other cell with the key. A negative key opts
+   * the cell out of the cache, for cells that depend on something the
+   * key can't capture (eg, distance gradients). If unset, a custom
+   * cellfunc is never cached and default_drawcell() uses default_cellkey().
+   */
+  int (*cellkey)(struct mazebitmap_s *, CELL */*cell*/);
+
+  /* PNG writing options, set to defaults by createmazebitmap().
+   * zlevel is the zlib compression level (ZLEVEL_DEFAULT or 0 to 9),
+   * filter is one of the FILTER_ values.
+   */
+  int zlevel;
+  int filter;
+
   /* A pointer to a user data structure (user responsible for free()ing) */
   void *udata;
 
@@ -129,6 +184,7 @@ typedef struct mazebitmap_s {
 /* for casting convience */
 typedef int (*CELLFUNC_P)(struct mazebitmap_s *, void *, CELL *);
 typedef void (*COLORFUNC_P)(struct mazebitmap_s *, CELL *, COLORDATA *);
+typedef int (*CELLKEY_P)(struct mazebitmap_s *, CELL *);
 
 
 
@@ -143,6 +199,13 @@ MAZEBITMAP *createmazebitmap(DMAP *);
  */
 void freemazebitmap(MAZEBITMAP *);
 
+/* Takes the same arguments as initmazebitmap() and sets up the MAZEBITMAP
+ * the same way, except no image memory is allocated. This is enough for
+ * streampng(). Returns as initmazebitmap() does.
+ */
+int setupmazebitmap(MAZEBITMAP *, int /* height */, int /* width */,
+	int /* colortype */, int /* colordepth */, int /* cell-or-maze*/ );
+
 /* Takes a height and width, a color type, a color depth, and a
  * flag CELL_SIZE or MAZE_SIZE to interpret the height and width,
  * then allocates the memory for the image.
@@ -154,6 +217,16 @@ int initmazebitmap(MAZEBITMAP *, int /* height */, int /* width */,
 	int /* colortype */, int /* colordepth */, int /* cell-or-maze*/ );
 
 
+/* For COLOR_PALETTE images: takes a COLORDATA of 8 bit RGB colors,
+ * puts each distinct color into the palette, and changes the COLORDATA
+ * to hold palette indices instead (in the first slot of each color), so
+ * cell drawing functions can use it unchanged. All of wall, edge, fg,
+ * bg, and uc1 to uc4 are used.
+ * Returns the number of palette entries, or -1 if not a palette image or
+ * if there are more colors than the colordepth can index.
+ */
+int setpalette(MAZEBITMAP *, COLORDATA *);
+
 /* Completely fill a cell with a color.
  * Count is the number of pixels in a cell, channels and twofer are used
  * to interpret the colors array, which is the same format as any of the
@@ -183,10 +256,15 @@ void draw_a_line(png_byte */* cellimage */,
  * this colorpicker routine kicks in. It uses the channels and depth values
  * in the COLORDATA struct to set the walls, edges, fg, and bg arrays.
  * In color images with non-trival distance maps, bg color is scaled to
- * distance.
+ * distance. Palette images get the default palette indices.
  */
 void default_colorpicker(MAZEBITMAP *, CELL *, COLORDATA *);
 
+/* The tile cache key used with default_drawcell(), made from the walls,
+ * edges, and background distance shading of the cell. Always >= 0.
+ */
+int default_cellkey(MAZEBITMAP *, CELL *);
+
 /* can place a cell image (or any other rectangle) onto the full
  * size image. This is divorced from the overall maze bitmap structure
  * just so it can be used for putting any rectangle into the image,
@@ -219,10 +297,20 @@ void placerectangle(png_byte */* cellimage */, int /* img_w */, int /* img_h */,
 int drawandplacecell(GRID *, CELL *, MAZEBITMAP *);
 
 /* Draws a maze into the maze bitmap. If the cellfunc is not defined,
- * supplies a default. Then iterates the drawandplacecell() function.
+ * supplies a default. With a cellkey (or the default cellfunc) each
+ * distinct tile is drawn once and copied to every cell with the same key,
+ * otherwise iterates the drawandplacecell() function. Returns the sum
+ * of cellfunc() return values either way, or -100 on memory error.
  */
 int drawmaze(MAZEBITMAP *);
 
+/* Same as drawmaze() but split over threads, each drawing whole rows of
+ * cells with its own scratch cell and tile cache. The output is the
+ * same as drawmaze(). cellfunc and cellkey must be safe to call from
+ * several threads at once (the defaults are). Returns as drawmaze().
+ */
+int pdrawmaze(MAZEBITMAP *, int /* threads */);
+
 /* PNM is a family of easy to read / write file formats that are terrible
  * long term use, but good for easy file interchange between programs.
  * The "N" stans for "aNy".
@@ -245,10 +333,31 @@ int drawmaze(MAZEBITMAP *);
 int writepnm(MAZEBITMAP *mb, char *filename);
 
 /* Write a PNG version of a maze bitmap.
- * This is (currently) the only function that actually uses libpng
- * functions (as opposed to libpng #defines and data types).
- * returns a 0 on success, or a negative value on failure.
+ * This and streampng() are the only functions that actually use libpng
+ * functions (as opposed to libpng #defines and data types). The zlevel
+ * and filter settings are passed on to libpng if not the defaults.
+ * returns a 0 on success, ZLEVEL_ERROR for a bad zlevel, or a negative
+ * value on other failures.
  */
 int writepng(MAZEBITMAP *mb, char *filename);
 
+/* Write a PNG version of a maze bitmap, deflating pieces of the image
+ * on several threads. The pieces are joined with sync flushes into one
+ * zlib stream, so any PNG reader can load it. Uses the zlevel and
+ * filter settings like writepng(), but the file will not be byte for
+ * byte the same as from writepng().
+ * returns a 0 on success, ZLEVEL_ERROR for a bad zlevel, or a negative
+ * value on other failures.
+ */
+int pwritepng(MAZEBITMAP *mb, char *filename, int /* threads */);
+
+/* Draws a maze and writes a PNG of it one band of cells at a time, so
+ * the whole bitmap is never in memory. Only needs setupmazebitmap()
+ * (rowsp is unused) and makes the same file as drawmaze() then
+ * writepng(). Returns the sum of cellfunc() return values, like
+ * drawmaze(), ZLEVEL_ERROR for a bad zlevel, or a negative value on
+ * memory or file failure.
+ */
+int streampng(MAZEBITMAP *mb, char *filename);
+
 #endif
@@ -1,18 +1,23 @@
 /* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
 /* ways to put a maze in a grid */
 
+#include <stdio.h>
 #include <stdlib.h>
-
-/* A macro system for several simple data structures, available on
- * BSD and Linux systems (and BSD in origin). The singlely-linked
- * list (SLIST_ family) of macros will be used to implement a stack.
- * SLIST_INSERT_HEAD() works like push() and SLIST_FIRST()/SLIST_REMOVE_HEAD()
- * paired work like pop(). malloc() your items to push, free() your pop'ed.
- */
-#include <sys/queue.h>
+#include <pthread.h>
 
 #include "mazes.h"
 
+/* connects c to cc (if there is a cc) through the grid, so that a
+ * connectivity plane, if enabled, stays in sync
+ */
+static
+void
+joincells(GRID *g, CELL *c, int go, CELL *cc)
+{
+  if(!cc) { return; }
+  connectbyid(g, c->id, go, cc->id, SYMMETRICAL);
+} /* joincells() */
+
 
 /* binary tree maze, iterategrid() call back */ 
 int
@@ -34,14 +39,14 @@ btreewalker(GRID *g, CELL *c, void*unused)
   } else if(edges & EAST_EDGE) {
     go = NORTH;
   } else {
-    if(random()%2 == 1) {
+    if(gridrandom(g) & 1) {
       go = EAST;
     } else {
       go = NORTH;
     }
   }
   cc = visitdir(g, c, go, ANY);
-  connectbycell(c, go, cc, SYMMETRICAL);
+  joincells(g, c, go, cc);
   return 0;
 } /* btreewalker() */
 
@@ -78,12 +83,12 @@ sidewinderwalker(GRID *g, CELL *c, void* status)
   } else if(edges & EAST_EDGE) {
     closeit = 1;
   } else {
-    closeit = (random()%2 == 1);
+    closeit = (gridrandom(g) & 1);
   }
 
   if(closeit) {
     go = NORTH;
-    nc = c->col - (random() % ts->runlength);
+    nc = c->col - gridrandrange(g, ts->runlength);
     oc = visitrc(g, c->row, nc);
     cc = visitdir(g, oc, go, ANY);
     ts->runlength = 0;
@@ -92,10 +97,111 @@ sidewinderwalker(GRID *g, CELL *c, void* status)
     cc = visitdir(g, c, go, ANY);
     oc = c;
   }
-  connectbycell(oc, go, cc, SYMMETRICAL);
+  joincells(g, oc, go, cc);
   return 0;
 } /* sidewinderwalker() */
 
+/* Shared state for pbinarytree() / psidewinder() threads. Rows are
+ * handed out PROW_CHUNK at a time; each row gets its own random number
+ * stream seeded from seed and the row number, so the maze made does
+ * not depend on how many threads there were or who did which rows.
+ */
+#define PROW_CHUNK	16
+
+typedef struct {
+  GRID *g;
+  int sidewinder;
+  int nextrow;
+  uint64_t seed;
+} PROWMAZE;
+
+static void *
+prowworker(void *arg)
+{
+  PROWMAZE *pr = (PROWMAZE *)arg;
+  GRID view = *(pr->g);	/* same cells, private random numbers */
+  sw_tree_status ts;
+  int row, last;
+
+  while(1) {
+    row = __atomic_fetch_add(&pr->nextrow, PROW_CHUNK, __ATOMIC_RELAXED);
+    if(row >= view.rows) { break; }
+    last = row + PROW_CHUNK;
+    if(last > view.rows) { last = view.rows; }
+
+    for( ; row < last; row ++) {
+      seedgrid(&view, pr->seed + row);
+      if(pr->sidewinder) {
+	ts.runlength = 0;
+	iteraterow(&view, row, sidewinderwalker, &ts);
+      } else {
+	iteraterow(&view, row, btreewalker, NULL);
+      }
+    }
+  }
+  return NULL;
+} /* prowworker() */
+
+/* Both tree mazes only ever connect a cell east or north, and decide
+ * using nothing but the cell's own row. So rows can be carved in
+ * parallel: the only cells two threads both touch are the north
+ * neighbors, and then in different dir[] slots. The connectivity plane
+ * packs two cells to a byte, so it is set aside and rebuilt after.
+ */
+static int
+prowmaze(GRID *g, int sidewinder, int threads)
+{
+  PROWMAZE pr;
+  pthread_t *tids;
+  unsigned char *plane;
+  int started;
+
+  if(!g) { return -1; }
+  if(threads < 1) { threads = 1; }
+
+  tids = (pthread_t *)malloc( threads * sizeof(pthread_t) );
+  if(!tids) { return -1; }
+
+  pr.g = g;
+  pr.sidewinder = sidewinder;
+  pr.nextrow = 0;
+  pr.seed = ((uint64_t)gridrandom(g) << 32) | gridrandom(g);
+
+  plane = g->plane;
+  g->plane = NULL;
+
+  for(started = 1; started < threads; started ++) {
+    if(pthread_create(&tids[started], NULL, prowworker, &pr)) {
+      break;
+    }
+  }
+  prowworker(&pr);
+  for(int t = 1; t < started; t ++) {
+    pthread_join(tids[t], NULL);
+  }
+  free(tids);
+
+  if(plane) {
+    g->plane = plane;
+    rebuildplane(g);
+  }
+  return 0;
+} /* prowmaze() */
+
+/* binary tree maze over the whole grid using threads */
+int
+pbinarytree(GRID *g, int threads)
+{
+  return prowmaze(g, 0, threads);
+} /* pbinarytree() */
+
+/* sidewinder maze over the whole grid using threads */
+int
+psidewinder(GRID *g, int threads)
+{
+  return prowmaze(g, 1, threads);
+} /* psidewinder() */
+
 /* serpentine grid walk, iterategrid() call back */ 
 int
 serpentine(GRID *g, CELL *c, void*unused)
@@ -112,20 +218,20 @@ serpentine(GRID *g, CELL *c, void*unused)
   if(edges & EAST_EDGE) {
     if(c->row % 2) {
       cc = visitdir(g, c, SOUTH, ANY);
-      connectbycell(c, SOUTH, cc, SYMMETRICAL);
+      joincells(g, c, SOUTH, cc);
     }
   }
 
   if(edges & WEST_EDGE) {
     if(0 == (c->row % 2)) {
       cc = visitdir(g, c, SOUTH, ANY);
-      connectbycell(c, SOUTH, cc, SYMMETRICAL);
+      joincells(g, c, SOUTH, cc);
     }
   }
 
   if(!(edges & EAST_EDGE)) {
     cc = visitdir(g, c, EAST, ANY);
-    connectbycell(c, EAST, cc, SYMMETRICAL);
+    joincells(g, c, EAST, cc);
   }
   return 0;
 } /* serpentine() */
@@ -163,7 +269,7 @@ hollow(GRID *g, CELL *c, HOLLOWCONFIG *hmode)
        		(c->ctype == t) && (cc->ctype == t))  ||
        ((mode == HMODE_DIFFERENT_STRICT) &&
        		(c->ctype != t) && (cc->ctype != t))    ) {
-      connectbycell(c, EAST, cc, SYMMETRICAL);
+      joincells(g, c, EAST, cc);
     }
   }
 
@@ -177,7 +283,7 @@ hollow(GRID *g, CELL *c, HOLLOWCONFIG *hmode)
        		(c->ctype == t) && (cc->ctype == t))  ||
        ((mode == HMODE_DIFFERENT_STRICT) &&
        		(c->ctype != t) && (cc->ctype != t))    ) {
-      connectbycell(c, SOUTH, cc, SYMMETRICAL);
+      joincells(g, c, SOUTH, cc);
     }
   }
 
@@ -190,7 +296,7 @@ hollow(GRID *g, CELL *c, HOLLOWCONFIG *hmode)
 
       if(((mode == HMODE_SAME_AS) && (c->ctype == t))   ||
          ((mode == HMODE_DIFFERENT) && (c->ctype != t))) {
-        connectbycell(c, WEST, cc, SYMMETRICAL);
+        joincells(g, c, WEST, cc);
       }
     }
 
@@ -199,7 +305,7 @@ hollow(GRID *g, CELL *c, HOLLOWCONFIG *hmode)
 
       if(((mode == HMODE_SAME_AS) && (c->ctype == t))   ||
          ((mode == HMODE_DIFFERENT) && (c->ctype != t))) {
-        connectbycell(c, NORTH, cc, SYMMETRICAL);
+        joincells(g, c, NORTH, cc);
       }
     }
   } /* loose hollow modes */
@@ -208,6 +314,72 @@ hollow(GRID *g, CELL *c, HOLLOWCONFIG *hmode)
 } /* hollow() */
 
 
+/* Random walks (aldbro() and wilson()) step from cell to cell many
+ * times over. Rather than pick any of the four directions and then
+ * reject edges and MASKED cells, they look up the usable exits of a
+ * cell, a bit per direction, and pick one of those with a single draw.
+ */
+static const unsigned char exitcount[16] = {
+  0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+};
+
+/* the n-th direction set in a four bit mask */
+static const signed char nthexit[16][4] = {
+  { -1, -1, -1, -1 },
+  {  0, -1, -1, -1 },
+  {  1, -1, -1, -1 },
+  {  0,  1, -1, -1 },
+  {  2, -1, -1, -1 },
+  {  0,  2, -1, -1 },
+  {  1,  2, -1, -1 },
+  {  0,  1,  2, -1 },
+  {  3, -1, -1, -1 },
+  {  0,  3, -1, -1 },
+  {  1,  3, -1, -1 },
+  {  0,  1,  3, -1 },
+  {  2,  3, -1, -1 },
+  {  0,  2,  3, -1 },
+  {  1,  2,  3, -1 },
+  {  0,  1,  2,  3 }
+};
+
+/* exits from each cell that stay on the grid and avoid MASKED cells */
+static unsigned char *
+walkexits(GRID *g)
+{
+  unsigned char *exits;
+  CELL *c, *nc;
+
+  exits = (unsigned char*) malloc( g->max );
+  if(!exits) { return NULL; }
+
+  for(int id = 0; id < g->max; id ++) {
+    c = quickvisitid(g, id);
+    exits[id] = 0;
+    for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+      nc = visitdir(g, c, go, ANY);
+      if(nc && (nc->ctype != MASKED)) { exits[id] |= 1 << go; }
+    }
+  }
+  return exits;
+} /* walkexits() */
+
+/* pick a random exit from a cell, NC if it has none */
+static int
+walkpick(GRID *g, unsigned char *exits, int id)
+{
+  int ex = exits[id];
+
+  if(!ex) { return NC; }
+  return nthexit[ex][gridrandrange(g, exitcount[ex])];
+} /* walkpick() */
+
+/* id of the neighbor in direction go, which must be on the grid */
+#define WALKSTEP(g,id,go)	( (id) + ((go) == NORTH? -(g)->cols: \
+				          (go) == SOUTH?  (g)->cols: \
+				          (go) == WEST ?  -1: 1) )
+
+
 /* Named for David Aldous and Andrei Broder, this method cannot
  * use the grid iterator because it needs to visit cells randomly,
  * and it needs to be able to revisit cells.
@@ -225,7 +397,7 @@ int
 aldbro(GRID *g, MASKSETTING *ms)
 {
   CELL *cc, *nc;
-  int edges;
+  unsigned char *exits;
   int tovisit;
   int visited;
   int unvisited;
@@ -264,38 +436,30 @@ aldbro(GRID *g, MASKSETTING *ms)
   cc->ctype = visited;
   tovisit --;
 
-  go = NEEDDIR;
+  exits = walkexits(g);
+  if(!exits) { return -1; }
 
   while(tovisit) {
 
-    edges = edgestatusbycell(g,cc);
-    
-    while( go > FOURDIRECTIONS ) {
-      go = FIRSTDIR + (random() % FOURDIRECTIONS);
-      if((go == NORTH) && (edges & NORTH_EDGE)) { go = NEEDDIR; }
-      if((go == SOUTH) && (edges & SOUTH_EDGE)) { go = NEEDDIR; }
-      if((go == WEST ) && (edges &  WEST_EDGE)) { go = NEEDDIR; }
-      if((go == EAST ) && (edges &  EAST_EDGE)) { go = NEEDDIR; }
-
-      if (go < NEEDDIR) {
-        nc = visitdir(g, cc, go, ANY);
-        if(!nc) { return -1; }
-        if(nc->ctype == MASKED) {                 go = NEEDDIR; }
-      }
-    } /* pick a viable direction */
-
+    go = walkpick(g, exits, cc->id);
+    if(go == NC) {
+      /* walled in by the mask */
+      free(exits);
+      return -1;
+    }
+    nc = quickvisitid(g, WALKSTEP(g, cc->id, go));
 
     if(nc->ctype == unvisited) {
       nc->ctype = visited;
       tovisit --;
-      connectbycell(cc, go, nc, SYMMETRICAL);
+      joincells(g, cc, go, nc);
     }
 
     cc = nc;
-    go = NEEDDIR;
 
   } /* while cells to visit */
 
+  free(exits);
   return 0;
 } /* aldbro() */
 
@@ -305,6 +469,12 @@ aldbro(GRID *g, MASKSETTING *ms)
  * the walks are removed before carving the path.
  * Relies on a grid being marked fully UNVISITED (ctype) to start.
  *
+ * The walk is kept as the last direction taken out of each cell in
+ * notes[]. Coming around a loop and leaving again overwrites the
+ * direction that started the loop, so following the notes from the
+ * start of the walk takes the loop erased path without any explicit
+ * erasing.
+ *
  * Cells originally not marked UNVISITED (eg MASKED) will not be
  * part of the maze. When using a mask, it is important to pass
  * in a count of cells to visit.
@@ -316,32 +486,24 @@ aldbro(GRID *g, MASKSETTING *ms)
 int
 wilson(GRID *g, MASKSETTING *ms)
 {
-  CELL *cc, *nc;
-  int edges;
+  CELL *cc, *nc, *start;
+  unsigned char *exits;
   int tovisit;
   int visited;
-  int wconsider;
   int unvisited;
   int go;
   int nid;
-  int wandering;
-  TRAIL *walk, trailhead;
   char *notes;
 
   if(!g) { return -1; }
-  notes = (char*) calloc( 1, g->max );
-
-  if(!notes) { return -1; }
 
   if(ms) {
     unvisited = ms->type_unvisited;
     visited   = ms->type_visited;
-    wconsider = ms->type_masked;
     tovisit   = ms->to_visit;
   } else {
     unvisited = UNVISITED;
     visited   = VISITED;
-    wconsider = WALK_CONSIDER;
     tovisit   = 0;
   }
 
@@ -358,107 +520,108 @@ wilson(GRID *g, MASKSETTING *ms)
     }
   } while( cc->ctype != unvisited );
 
+  notes = (char*) calloc( 1, g->max );
+  if(!notes) { return -1; }
+  exits = walkexits(g);
+  if(!exits) { free(notes); return -1; }
+
   cc->ctype = visited;
-  notes[cc->id] = visited;
+  notes[cc->id] = WALK_INTREE;
   tovisit --;
 
-  trailhead.next = NULL;
-  trailhead.prev = NULL;
-
-  while(tovisit) {
-
-    if(tovisit < 0) {
-      /* shouldn't happen */
-      return -1;
-    }
+  while(tovisit > 0) {
 
     /* Find somewhere fresh to start the walk */
     do {
-      cc = visitrandom(g);
-    } while (cc->ctype != unvisited);
-
-    notes[cc->id] = wconsider;
-    trailhead.cell_id = cc->id;
-    walk = &trailhead;
-    wandering = 1; 
-    go = NEEDDIR;
-    
-    while ( wandering ) {
-      edges = edgestatusbycell(g,cc);
-    
-      while( go > FOURDIRECTIONS ) {
-	go = FIRSTDIR + (random() % FOURDIRECTIONS);
-	if((go == NORTH) && (edges & NORTH_EDGE)) { go = NEEDDIR; }
-	if((go == SOUTH) && (edges & SOUTH_EDGE)) { go = NEEDDIR; }
-	if((go == WEST ) && (edges &  WEST_EDGE)) { go = NEEDDIR; }
-	if((go == EAST ) && (edges &  EAST_EDGE)) { go = NEEDDIR; }
-
-	if (go < NEEDDIR) {
-	  nc = visitdir(g, cc, go, ANY);
-	  if(!nc) { return -1; }
-	  if(nc->ctype == MASKED) {                 go = NEEDDIR; }
-	}
-      } /* pick a viable direction */
-
-      if(notes[nc->id] == wconsider) {
-        /* loop detected, backtrack */
-
-	while(walk->cell_id != nc->id) {
-	  notes[walk->cell_id] = 0;
-	  walk = walk->prev;
-	  free(walk->next);
-          walk->next = NULL;
-	} /* walking back */
-
-	cc = visitid(g, walk->cell_id);
-	go = NEEDDIR;
-	continue; /* wandering */
-      } 
-        
-      walk->next = (TRAIL*)malloc(sizeof(TRAIL));
-      if(!walk->next) { return -1; } /* leaks memory, on out of memory... */
-      walk->next->prev = walk;
-      walk = walk->next;
-      walk->next = NULL;
-      walk->cell_id = nc->id;
-
-      if(notes[nc->id] == visited) {
-        wandering = 0;
-      } else {
-        notes[nc->id] = wconsider;
-	cc = nc;
-        go = NEEDDIR;
+      start = visitrandom(g);
+    } while (start->ctype != unvisited);
+
+    /* wander until reaching the maze so far */
+    cc = start;
+    while ( notes[cc->id] != WALK_INTREE ) {
+      go = walkpick(g, exits, cc->id);
+      if(go == NC) {
+        /* walled in by the mask */
+	free(exits);
+	free(notes);
+	return -1;
       }
-    } /* while wandering */
 
-    /* We have a trail, walk it back marking visited */
-    while ( walk != &trailhead ) {
-      tovisit --;
-      notes[walk->cell_id] = visited;
-      nc->ctype = visited;
+      notes[cc->id] = go;
+      cc = quickvisitid(g, WALKSTEP(g, cc->id, go));
+    } /* while wandering */
 
-      walk = walk->prev;
-      free(walk->next);
-      cc = visitid(g, walk->cell_id);
-      go = natdirectionbycell(cc, nc);
+    /* follow the notes from the start, carving and marking visited */
+    cc = start;
+    while ( notes[cc->id] != WALK_INTREE ) {
+      go = notes[cc->id];
+      nc = quickvisitid(g, WALKSTEP(g, cc->id, go));
 
-      connectbycell(cc, go, nc, SYMMETRICAL);
-      nc = cc;
+      tovisit --;
+      notes[cc->id] = WALK_INTREE;
+      cc->ctype = visited;
+      joincells(g, cc, go, nc);
+      cc = nc;
     } /* marking the trail */
 
-    notes[walk->cell_id] = visited;
-    nc->ctype = visited;
-
   } /* while cells to visit */
 
+  free(exits);
+  free(notes);
   return 0;
 } /* wilson() */
 
+/* Hunt candidates for huntandkill(): a bit per cell, set for every
+ * unvisited cell next to a visited one. low is the lowest word that
+ * might have a bit set, so hunts resume where the last one left off
+ * unless a kill walk has since made a new candidate further back.
+ */
+#define HUNTBIT(id)	( (uint64_t)1 << ((id) & 63) )
+
+/* cell c has just been visited */
+static void
+huntupdate(GRID *g, uint64_t *cand, int *low, CELL *c, int unvisited)
+{
+  CELL *nc;
+
+  cand[c->id >> 6] &= ~HUNTBIT(c->id);
+  for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+    nc = visitdir(g, c, go, ANY);
+    if(nc && (nc->ctype == unvisited)) {
+      cand[nc->id >> 6] |= HUNTBIT(nc->id);
+      if((nc->id >> 6) < *low) { *low = nc->id >> 6; }
+    }
+  }
+} /* huntupdate() */
+
+/* lowest numbered candidate, or NC if none */
+static int
+huntfirst(uint64_t *cand, int words, int *low)
+{
+  uint64_t w;
+  int bit;
+
+  while((*low < words) && !cand[*low]) { (*low) ++; }
+  if(*low == words) { return NC; }
+
+  w = cand[*low];
+#ifdef __GNUC__
+  bit = __builtin_ctzll(w);
+#else
+  for(bit = 0; !(w & 1); bit ++) { w >>= 1; }
+#endif
+  return (*low << 6) + bit;
+} /* huntfirst() */
+
 /*
  * Hunt-and-kill alternates hunting for unseen spaces and killing
  * them with a random walk ending when finding a perviously visited
  * cell. 
  *
+ * The hunt picks the lowest id unvisited cell with a visited neighbor.
+ * Rather than rescan the grid for that, a bitset of such cells is kept
+ * up to date as cells are visited (see huntupdate()).
+ *
  * Relies on a grid being marked fully UNVISITED (ctype) to start.
  *
  * The masksetting can change the default values for VISITED and
@@ -476,6 +639,8 @@ huntandkill(GRID *g, MASKSETTING *ms)
   int tovisit;
   int nid;
   int go, dir;
+  uint64_t *cand;
+  int words, low;
 
   if(!g) { return -1; }
 
@@ -493,21 +658,36 @@ huntandkill(GRID *g, MASKSETTING *ms)
 
   if(tovisit < 1) { tovisit = g->max; }
 
+  words = (g->max + 63) >> 6;
+  cand = (uint64_t*) calloc( words, sizeof(uint64_t) );
+  if(!cand) { return -1; }
+  low = words;
+
+  /* in case some cells start out visited */
+  for(nid = 0; nid < g->max; nid ++) {
+    cc = quickvisitid(g, nid);
+    if(cc->ctype == visited) { huntupdate(g, cand, &low, cc, unvisited); }
+  }
+
   /* first hunt is the easiest */
   cc = visitrandom(g);
-  if(!cc) { return -1; }
+  if(!cc) {
+    free(cand);
+    return -1;
+  }
 
   nid = cc->id;
   while( cc->ctype != unvisited ) {
     nid ++;
     cc = visitid(g, nid % g->max );
-    if(!cc) { return -1; }
     if( nid > (2 * g->max) ) {
       /* don't loop forever */
+      free(cand);
       return -1;
     }
   }
   cc->ctype = visited;
+  huntupdate(g, cand, &low, cc, unvisited);
   tovisit --;
 
   go = NEEDDIR;
@@ -518,7 +698,7 @@ huntandkill(GRID *g, MASKSETTING *ms)
 
     edges = edgestatusbycell(g,cc);
     
-    dir = (random() % FOURDIRECTIONS);
+    dir = gridrandrange(g, FOURDIRECTIONS);
     for (int a = 0; a < 4; a ++) {
       go = FIRSTDIR + (dir + a) % 4;
       if((go == NORTH) && (edges & NORTH_EDGE)) { continue; }
@@ -527,7 +707,7 @@ huntandkill(GRID *g, MASKSETTING *ms)
       if((go == EAST ) && (edges &  EAST_EDGE)) { continue; }
 
       nc = visitdir(g, cc, go, ANY);
-      if(!nc) { return -1; }
+      if(!nc) { free(cand); return -1; }
       if(nc->ctype == unvisited) { break; }
     } /* pick a good direction */
 
@@ -537,8 +717,9 @@ huntandkill(GRID *g, MASKSETTING *ms)
      */
     if(nc->ctype == unvisited) {
       nc->ctype = visited;
+      huntupdate(g, cand, &low, nc, unvisited);
       tovisit --;
-      connectbycell(cc, go, nc, SYMMETRICAL);
+      joincells(g, cc, go, nc);
       cc = nc;
       go = NEEDDIR;
 
@@ -549,26 +730,25 @@ huntandkill(GRID *g, MASKSETTING *ms)
      * different one.
      */
     if(tovisit) {
-      int id;
-      for (id = 0; id < g->max; id ++) {
-        cc = visitid(g,id);
-	if( cc->ctype == unvisited ) {
-	  if( ncountbycell(g, cc, OF_TYPE, visited) ) {
-	    /* found a suitable cell:
-	     * not previously visited
-	     * next to a visited
-	     */
-	    cc->ctype = visited;
-	    tovisit --;
-	    break;
-	  }
-	}
-      } /* finding a cell */
+      /* a suitable cell is
+       * not previously visited
+       * next to a visited
+       */
+      nid = huntfirst(cand, words, &low);
+      if(nid == NC) {
+        /* the rest can't be reached, a bad mask or to_visit count */
+	free(cand);
+	return -1;
+      }
+      cc = quickvisitid(g, nid);
+      cc->ctype = visited;
+      huntupdate(g, cand, &low, cc, unvisited);
+      tovisit --;
 
       /* have a suitable current cell (cc)
        * find one of the visited neighbors and join them
        */
-      dir = (random() % FOURDIRECTIONS);
+      dir = gridrandrange(g, FOURDIRECTIONS);
       edges = edgestatusbycell(g,cc);
       for (int a = 0; a < 4; a ++) {
 	go = FIRSTDIR + (dir + a) % 4;
@@ -579,7 +759,7 @@ huntandkill(GRID *g, MASKSETTING *ms)
 
         nc = visitdir(g, cc, go, ANY);
 	if(nc && (nc->ctype == visited) ) {
-          connectbycell(cc, go, nc, SYMMETRICAL);
+          joincells(g, cc, go, nc);
 	  break;
 	} 
       } /* pick a random dir and (if okay) make a link */
@@ -588,6 +768,7 @@ huntandkill(GRID *g, MASKSETTING *ms)
     go = NEEDDIR;
   } /* while cells to visit (main loop) */
 
+  free(cand);
   return 0;
 } /* huntandkill() */
 
@@ -610,8 +791,8 @@ int
 backtracker(GRID *g, MASKSETTING *ms)
 {
   CELL *cc, *nc;
-  SLIST_HEAD(bthead_s, backtrack_s) stack;
-  backtrack_stack_t *step;
+  int *stack, *bigger;	/* cell ids on the current path */
+  int depth, room;
   int unvisited;
   int visited;
   int masked;
@@ -621,7 +802,6 @@ backtracker(GRID *g, MASKSETTING *ms)
   int go, dir;
 
   if(!g) { return -1; }
-  SLIST_INIT(&stack);
 
   if(ms) {
     unvisited = ms->type_unvisited;
@@ -655,19 +835,28 @@ backtracker(GRID *g, MASKSETTING *ms)
   cc->ctype = visited;
   tovisit --;
 
+  /* grows by doubling, but never needs more than one slot per cell */
+  room = (tovisit < 1024)? tovisit + 1: 1024;
+  stack = (int*)malloc( room * sizeof(int) );
+  if(!stack) { return -5; }
+  depth = 0;
+
   while(tovisit) {
 
     /* let's wander */
 
     edges = edgestatusbycell(g,cc);
 
-    step = (backtrack_stack_t*) malloc( sizeof(backtrack_stack_t) );
-    step->cell  = cc;
-
     /* push */
-    SLIST_INSERT_HEAD(&stack, step, trail);
+    if(depth == room) {
+      room *= 2;
+      bigger = (int*)realloc(stack, room * sizeof(int));
+      if(!bigger) { free(stack); return -5; }
+      stack = bigger;
+    }
+    stack[depth ++] = cc->id;
 
-    dir = (random() % FOURDIRECTIONS);
+    dir = gridrandrange(g, FOURDIRECTIONS);
     for (int a = 0; a < 4; a ++) {
       go = FIRSTDIR + (dir + a) % 4;
       if((go == NORTH) && (edges & NORTH_EDGE)) { continue; }
@@ -676,7 +865,7 @@ backtracker(GRID *g, MASKSETTING *ms)
       if((go == EAST ) && (edges &  EAST_EDGE)) { continue; }
 
       nc = visitdir(g, cc, go, ANY);
-      if(!nc) { return -4; }
+      if(!nc) { free(stack); return -4; }
       if(nc->ctype == unvisited) { break; }
     } /* pick a good direction */
 
@@ -687,7 +876,7 @@ backtracker(GRID *g, MASKSETTING *ms)
     if(nc->ctype == unvisited) {
       nc->ctype = visited;
       tovisit --;
-      connectbycell(cc, go, nc, SYMMETRICAL);
+      joincells(g, cc, go, nc);
       cc = nc;
 
       continue; /* wander some more */
@@ -695,11 +884,9 @@ backtracker(GRID *g, MASKSETTING *ms)
 
     /* the new cell (nc) was a dead end, backtrack */
     if(tovisit) {
-      while(!SLIST_EMPTY(&stack)) {
+      while(depth) {
 	/* pop */
-        step = SLIST_FIRST(&stack); SLIST_REMOVE_HEAD(&stack, trail);
-	cc = step->cell;
-	free(step);
+	cc = quickvisitid(g, stack[-- depth]);
 	if( ncountbycell(g, cc, OF_TYPE, unvisited) ) {
 	  break;
 	}
@@ -709,17 +896,602 @@ backtracker(GRID *g, MASKSETTING *ms)
 
   } /* while cells to visit (main loop) */
 
-  /* clean up rest of stack */
-  while(!SLIST_EMPTY(&stack)) {
-    /* pop */
-    step = SLIST_FIRST(&stack); SLIST_REMOVE_HEAD(&stack, trail);
-    free(step);
-  }
-    
+  free(stack);
   return 0;
 } /* backtracker() */
 
 
+/* union-find lookup with path halving, for eller() and kruskal() */
+static int
+setfind(int *parent, int id)
+{
+  while(parent[id] != id) {
+    parent[id] = parent[parent[id]];
+    id = parent[id];
+  }
+  return id;
+} /* setfind() */
+
+/* Eller's algorithm works down the maze a row at a time, and only
+ * needs to know which cells of the current row are already joined
+ * (are in the same set). Within a row, neighbors in different sets are
+ * randomly joined east-west; then every set gets at least one passage
+ * south, and the cells below those carry the set into the next row.
+ * The last row joins everything left apart. Set ids are kept below
+ * cols by reusing ids no longer in use, and joins within a row use a
+ * union-find on those ids.
+ */
+
+/* Generate a rows x cols perfect maze, calling rowfunc(row, param) for
+ * each finished row in order. Memory use depends only on cols.
+ * Returns 0, negative on error, or the first negative rowfunc() return.
+ */
+int
+eller(int rows, int cols, uint64_t seed, ELLERFUNC_P rowfunc, void *param)
+{
+  ELLERROW er;
+  uint64_t rng[4];
+  int *set, *parent, *seen, *pick;
+  unsigned char *south, *used;
+  int a, b, fresh, rc = 0;
+
+  if((rows < 1) || (cols < 1) || !rowfunc) { return -1; }
+
+  set    = (int*) malloc( 4 * cols * sizeof(int) );
+  er.open = (unsigned char*) malloc( 3 * cols );
+  if(!set || !er.open) {
+    free(set);
+    free(er.open);
+    return -1;
+  }
+  parent = set + cols;
+  seen   = set + 2 * cols;	/* per set: cells in this row */
+  pick   = set + 3 * cols;	/* per set: randomly chosen cell */
+  south  = er.open + cols;	/* per set: has a passage south */
+  used   = er.open + 2 * cols;	/* per id: carried into the next row */
+
+  seedrng(rng, seed);
+  er.rows = rows;
+  er.cols = cols;
+
+  /* first row, every cell on its own */
+  for(int j = 0; j < cols; j ++) {
+    set[j] = parent[j] = j;
+    er.open[j] = 0;
+  }
+
+  for(er.row = 0; er.row < rows; er.row ++) {
+    int last = (er.row == rows - 1);
+
+    /* east-west joins, forced on the last row */
+    for(int j = 0; j < cols - 1; j ++) {
+      a = setfind(parent, set[j]);
+      b = setfind(parent, set[j + 1]);
+      if((a != b) && (last || (rngrandom(rng) & 1))) {
+	parent[b] = a;
+	er.open[j]     |= 1 << EAST;
+	er.open[j + 1] |= 1 << WEST;
+      }
+    }
+
+    if(!last) {
+      /* random passages south, one picked member per set as backup */
+      for(int j = 0; j < cols; j ++) {
+	set[j] = setfind(parent, set[j]);
+	seen[set[j]] = 0;
+	south[set[j]] = 0;
+      }
+      for(int j = 0; j < cols; j ++) {
+	a = set[j];
+	seen[a] ++;
+	if(rngrange(rng, seen[a]) == 0) { pick[a] = j; }
+	if(rngrandom(rng) & 1) {
+	  er.open[j] |= 1 << SOUTH;
+	  south[a] = 1;
+	}
+      }
+      for(int j = 0; j < cols; j ++) {
+	a = set[j];
+	if(!south[a]) {
+	  er.open[pick[a]] |= 1 << SOUTH;
+	  south[a] = 1;
+	}
+      }
+    }
+
+    rc = rowfunc(&er, param);
+    if(rc < 0) { break; }
+    rc = 0;
+    if(last) { break; }
+
+    /* next row: cells below a passage keep the set, others get an
+     * id not carried down
+     */
+    for(int j = 0; j < cols; j ++) { used[j] = 0; }
+    for(int j = 0; j < cols; j ++) {
+      if(er.open[j] & (1 << SOUTH)) { used[set[j]] = 1; }
+    }
+    fresh = 0;
+    for(int j = 0; j < cols; j ++) {
+      if(er.open[j] & (1 << SOUTH)) {
+	er.open[j] = 1 << NORTH;
+      } else {
+	while(used[fresh]) { fresh ++; }
+	set[j] = fresh ++;
+	er.open[j] = 0;
+      }
+    }
+    for(int j = 0; j < cols; j ++) { parent[j] = j; }
+  } /* for each row */
+
+  free(set);
+  free(er.open);
+  return rc;
+} /* eller() */
+
+/* eller() row call back: carve the row into a GRID of the same size */
+int
+ellergridrow(ELLERROW *er, void *grid)
+{
+  GRID *g = (GRID *)grid;
+  CELL *c;
+
+  if(!g || (er->cols != g->cols) || (er->row >= g->rows)) { return -1; }
+
+  for(int j = 0; j < er->cols; j ++) {
+    c = quickvisitrc(g, er->row, j);
+    if(er->open[j] & (1 << NORTH)) {
+      joincells(g, c, NORTH, quickvisitrc(g, er->row - 1, j));
+    }
+    if(er->open[j] & (1 << EAST)) {
+      joincells(g, c, EAST, quickvisitrc(g, er->row, j + 1));
+    }
+  }
+  return 0;
+} /* ellergridrow() */
+
+/* eller() row call back: print the row to a FILE * in the same ASCII
+ * art as ascii_grid() would
+ */
+int
+ellerasciirow(ELLERROW *er, void *file)
+{
+  FILE *f = (FILE *)file;
+  int j;
+
+  if(!f) { return -1; }
+
+  for(j = 0; j < er->cols; j ++) {
+    fputs((er->open[j] & (1 << NORTH))? "+   ": "+---", f);
+  }
+  fputs("+\n", f);
+  for(j = 0; j < er->cols; j ++) {
+    fputs((er->open[j] & (1 << WEST))? "    ": "|   ", f);
+  }
+  fputs("|\n", f);
+
+  if(er->row == er->rows - 1) {
+    for(j = 0; j < er->cols; j ++) { fputs("+---", f); }
+    fputs("+\n", f);
+  }
+  if(ferror(f)) { return -2; }
+  return 0;
+} /* ellerasciirow() */
+
+/*
+ * Randomized Kruskal's: every wall between two cells of the maze is
+ * taken down in random order, unless the cells on either side are
+ * already joined. A union-find over cell ids (path halving, union by
+ * rank) answers that, so the run time doesn't depend on the luck of a
+ * random walk. The walls are shuffled as they are used, which lets it
+ * stop as soon as everything is joined.
+ *
+ * Cells not marked UNVISITED (eg MASKED) will not be part of the
+ * maze, and all UNVISITED ones become VISITED. The to_visit count is
+ * not needed here, the cells get counted. If the mask splits the grid,
+ * each piece is a separate maze.
+ */
+int
+kruskal(GRID *g, MASKSETTING *ms)
+{
+  CELL *c;
+  int *walls, *parent;
+  unsigned char *rank;
+  int unvisited, visited;
+  int tovisit = 0;	/* counted, to know when all are joined */
+  int nwalls, joins, w, t, id, nid, go, a, b;
+
+  if(!g) { return -1; }
+
+  if(ms) {
+    unvisited = ms->type_unvisited;
+    visited   = ms->type_visited;
+  } else {
+    unvisited = UNVISITED;
+    visited   = VISITED;
+  }
+
+  walls  = (int*) malloc( 3 * g->max * sizeof(int) );
+  rank   = (unsigned char*) calloc( 1, g->max );
+  if(!walls || !rank) {
+    free(walls);
+    free(rank);
+    return -1;
+  }
+  parent = walls + 2 * g->max;
+
+  /* walls east and south of each cell, as id * 2 + (south? 1: 0) */
+  nwalls = 0;
+  for(id = 0; id < g->max; id ++) {
+    parent[id] = id;
+    c = quickvisitid(g, id);
+    if(c->ctype != unvisited) { continue; }
+    tovisit ++;
+
+    if((c->col < g->cols - 1) &&
+       (quickvisitid(g, id + 1)->ctype == unvisited)) {
+      walls[nwalls ++] = id * 2;
+    }
+    if((c->row < g->rows - 1) &&
+       (quickvisitid(g, id + g->cols)->ctype == unvisited)) {
+      walls[nwalls ++] = id * 2 + 1;
+    }
+  }
+
+  joins = 0;
+  for(w = 0; (w < nwalls) && (joins < tovisit - 1); w ++) {
+    /* Fisher-Yates, one step at a time */
+    t = w + gridrandrange(g, nwalls - w);
+    id = walls[t]; walls[t] = walls[w]; walls[w] = id;
+
+    id = walls[w] >> 1;
+    if(walls[w] & 1) {
+      go = SOUTH; nid = id + g->cols;
+    } else {
+      go = EAST;  nid = id + 1;
+    }
+
+    a = setfind(parent, id);
+    b = setfind(parent, nid);
+    if(a == b) { continue; }
+
+    if(rank[a] < rank[b]) {
+      parent[a] = b;
+    } else {
+      parent[b] = a;
+      if(rank[a] == rank[b]) { rank[a] ++; }
+    }
+    connectbyid(g, id, go, nid, SYMMETRICAL);
+    joins ++;
+  } /* for each wall */
+
+  for(id = 0; id < g->max; id ++) {
+    c = quickvisitid(g, id);
+    if(c->ctype == unvisited) { c->ctype = visited; }
+  }
+
+  free(walls);
+  free(rank);
+  return 0;
+} /* kruskal() */
+
+/*
+ * The growing tree family keeps a set of active cells: pick one, carve
+ * to a random UNVISITED neighbor and add that to the set, or drop the
+ * cell from the set if it has none. Which cell gets picked sets the
+ * texture: GROW_NEWEST is the recursive backtracker's long winding
+ * passages, GROW_RANDOM is like Prim's with lots of short dead ends,
+ * GROW_OLDEST makes long straight runs out from the start, and
+ * GROW_MIXED picks newest or random half the time each.
+ *
+ * The active set is one array of cell ids, allocated once: a cell is
+ * appended when visited and never comes back once dropped, so
+ * GROW_OLDEST can just move a head index along, GROW_NEWEST pops, and
+ * random picks swap the last active cell into the gap. The cell's
+ * ctype (VISITED) already marks everything that is or was in the set.
+ *
+ * Cells not marked UNVISITED (eg MASKED) will not be part of the maze.
+ * The to_visit count isn't needed, it stops when the set is empty.
+ */
+int
+growingtree(GRID *g, MASKSETTING *ms, int policy)
+{
+  CELL *cc, *nc;
+  int *active;
+  int head, tail, pick, nid;
+  int unvisited, visited;
+  int ex, go;
+
+  if(!g) { return -1; }
+  if((policy < GROW_NEWEST) || (policy > GROW_MIXED)) { return -1; }
+
+  if(ms) {
+    unvisited = ms->type_unvisited;
+    visited   = ms->type_visited;
+  } else {
+    unvisited = UNVISITED;
+    visited   = VISITED;
+  }
+
+  /* start anywhere */
+  cc = visitrandom(g);
+  nid = cc->id;
+  while( cc->ctype != unvisited ) {
+    nid ++;
+    if( nid > (2 * g->max) ) {
+      /* don't loop forever */
+      return -1;
+    }
+    cc = quickvisitid(g, nid % g->max );
+  }
+
+  active = (int*) malloc( g->max * sizeof(int) );
+  if(!active) { return -1; }
+
+  cc->ctype = visited;
+  head = 0;
+  tail = 0;
+  active[tail ++] = cc->id;
+
+  while(head < tail) {
+    switch(policy) {
+      case GROW_NEWEST: pick = tail - 1; break;
+      case GROW_OLDEST: pick = head; break;
+      case GROW_RANDOM: pick = head + gridrandrange(g, tail - head); break;
+      default:
+	if(gridrandom(g) & 1) {
+	  pick = tail - 1;
+	} else {
+	  pick = head + gridrandrange(g, tail - head);
+	}
+    }
+    cc = quickvisitid(g, active[pick]);
+
+    /* unvisited neighbors, a bit per direction */
+    ex = 0;
+    if((cc->row > 0) &&
+       (quickvisitid(g, cc->id - g->cols)->ctype == unvisited)) {
+      ex |= 1 << NORTH;
+    }
+    if((cc->col > 0) &&
+       (quickvisitid(g, cc->id - 1)->ctype == unvisited)) {
+      ex |= 1 << WEST;
+    }
+    if((cc->col < g->cols - 1) &&
+       (quickvisitid(g, cc->id + 1)->ctype == unvisited)) {
+      ex |= 1 << EAST;
+    }
+    if((cc->row < g->rows - 1) &&
+       (quickvisitid(g, cc->id + g->cols)->ctype == unvisited)) {
+      ex |= 1 << SOUTH;
+    }
+
+    if(ex) {
+      go = nthexit[ex][gridrandrange(g, exitcount[ex])];
+      nc = quickvisitid(g, WALKSTEP(g, cc->id, go));
+      nc->ctype = visited;
+      joincells(g, cc, go, nc);
+      active[tail ++] = nc->id;
+      continue;
+    }
+
+    /* dead, drop it from the set */
+    if(pick == head) {
+      head ++;
+    } else {
+      active[pick] = active[-- tail];
+    }
+  } /* while cells are active */
+
+  free(active);
+  return 0;
+} /* growingtree() */
+
+/* Recursive division works the other way from the other generators:
+ * start with everything open (hollow()) and add walls. A chamber gets
+ * a wall across it with a single gap, making two smaller chambers,
+ * until chambers are a cell wide. Chambers never share cells, so once
+ * split they can be worked on by different threads.
+ *
+ * Each chamber carries its own random seed, and splitting draws seeds
+ * for the two halves, so the maze doesn't depend on which thread did
+ * what. Chambers of PDIVIDE_TASK cells or more go on a shared list for
+ * any thread to take, smaller ones are finished by the thread that
+ * made them.
+ */
+#define PDIVIDE_TASK	4096
+
+typedef struct {
+  int row, col;		/* top left */
+  int rows, cols;
+  uint64_t seed;
+} CHAMBER;
+
+typedef struct {
+  GRID *g;
+  CHAMBER *tasks;	/* shared list of big chambers */
+  int ntasks, room;
+  int busy;		/* threads working on a chamber */
+  int failed;
+  pthread_mutex_t lock;
+  pthread_cond_t more;
+} PDIVIDE;
+
+/* add a chamber to a growable list, returns -1 if out of memory */
+static int
+chamberpush(CHAMBER **list, int *n, int *room, CHAMBER *ch)
+{
+  CHAMBER *bigger;
+
+  if(*n == *room) {
+    *room = (*room)? *room * 2: 64;
+    bigger = (CHAMBER *)realloc(*list, *room * sizeof(CHAMBER));
+    if(!bigger) { return -1; }
+    *list = bigger;
+  }
+  (*list)[(*n) ++] = *ch;
+  return 0;
+} /* chamberpush() */
+
+/* put one wall across a chamber, filling in the two halves */
+static void
+chambersplit(GRID *g, CHAMBER *ch, CHAMBER *a, CHAMBER *b)
+{
+  uint64_t rng[4];
+  int across, at, gap;
+  CELL *c;
+
+  seedrng(rng, ch->seed);
+  if(ch->rows > ch->cols) {
+    across = 1;
+  } else if(ch->rows < ch->cols) {
+    across = 0;
+  } else {
+    across = rngrandom(rng) & 1;
+  }
+
+  *a = *ch;
+  *b = *ch;
+  if(across) {
+    /* wall south of row at, gap in one column */
+    at  = ch->row + rngrange(rng, ch->rows - 1);
+    gap = ch->col + rngrange(rng, ch->cols);
+    for(int j = ch->col; j < ch->col + ch->cols; j ++) {
+      if(j == gap) { continue; }
+      c = quickvisitrc(g, at, j);
+      disconnectbycell(c, SOUTH, quickvisitrc(g, at + 1, j), SYMMETRICAL);
+    }
+    a->rows = at + 1 - ch->row;
+    b->row  = at + 1;
+    b->rows = ch->rows - a->rows;
+  } else {
+    /* wall east of column at, gap in one row */
+    at  = ch->col + rngrange(rng, ch->cols - 1);
+    gap = ch->row + rngrange(rng, ch->rows);
+    for(int i = ch->row; i < ch->row + ch->rows; i ++) {
+      if(i == gap) { continue; }
+      c = quickvisitrc(g, i, at);
+      disconnectbycell(c, EAST, quickvisitrc(g, i, at + 1), SYMMETRICAL);
+    }
+    a->cols = at + 1 - ch->col;
+    b->col  = at + 1;
+    b->cols = ch->cols - a->cols;
+  }
+  a->seed = ((uint64_t)rngrandom(rng) << 32) | rngrandom(rng);
+  b->seed = ((uint64_t)rngrandom(rng) << 32) | rngrandom(rng);
+} /* chambersplit() */
+
+static void *
+pdivideworker(void *arg)
+{
+  PDIVIDE *pd = (PDIVIDE *)arg;
+  CHAMBER *stack = NULL;
+  CHAMBER ch, half[2];
+  int depth = 0, room = 0, failed = 0;
+
+  pthread_mutex_lock(&pd->lock);
+  while(1) {
+    while(!pd->ntasks && pd->busy && !pd->failed) {
+      pthread_cond_wait(&pd->more, &pd->lock);
+    }
+    if(!pd->ntasks || pd->failed) { break; }
+    ch = pd->tasks[-- pd->ntasks];
+    pd->busy ++;
+    pthread_mutex_unlock(&pd->lock);
+
+    /* finish this chamber, sharing any big pieces */
+    depth = 0;
+    while(1) {
+      if((ch.rows > 1) && (ch.cols > 1)) {
+	chambersplit(pd->g, &ch, &half[0], &half[1]);
+	for(int h = 0; h < 2; h ++) {
+	  if(half[h].rows * half[h].cols >= PDIVIDE_TASK) {
+	    pthread_mutex_lock(&pd->lock);
+	    failed |= chamberpush(&pd->tasks, &pd->ntasks, &pd->room,
+				&half[h]);
+	    pthread_cond_signal(&pd->more);
+	    pthread_mutex_unlock(&pd->lock);
+	  } else {
+	    failed |= chamberpush(&stack, &depth, &room, &half[h]);
+	  }
+	}
+      }
+      if(!depth || failed) { break; }
+      ch = stack[-- depth];
+    }
+
+    pthread_mutex_lock(&pd->lock);
+    if(failed) { pd->failed = 1; }
+    pd->busy --;
+    if(!pd->busy) { pthread_cond_broadcast(&pd->more); }
+  }
+  pthread_cond_broadcast(&pd->more);
+  pthread_mutex_unlock(&pd->lock);
+
+  free(stack);
+  return NULL;
+} /* pdivideworker() */
+
+/* Recursive division maze over the whole grid using threads. Clears
+ * all walls first, cell types are ignored. Returns 0, or negative on
+ * error.
+ */
+int
+recursivedivision(GRID *g, int threads)
+{
+  PDIVIDE pd;
+  CHAMBER whole;
+  pthread_t *tids;
+  unsigned char *plane;
+  int started;
+
+  if(!g) { return -1; }
+  if(threads < 1) { threads = 1; }
+
+  tids = (pthread_t *)malloc( threads * sizeof(pthread_t) );
+  if(!tids) { return -1; }
+
+  iterategrid(g, (IFUNC_P) hollow, NULL);
+
+  whole.row = whole.col = 0;
+  whole.rows = g->rows;
+  whole.cols = g->cols;
+  whole.seed = ((uint64_t)gridrandom(g) << 32) | gridrandom(g);
+
+  pd.g = g;
+  pd.tasks = NULL;
+  pd.ntasks = pd.room = 0;
+  pd.busy = 0;
+  pd.failed = chamberpush(&pd.tasks, &pd.ntasks, &pd.room, &whole);
+  pthread_mutex_init(&pd.lock, NULL);
+  pthread_cond_init(&pd.more, NULL);
+
+  /* two cells to a byte in the plane, so it can't be shared */
+  plane = g->plane;
+  g->plane = NULL;
+
+  for(started = 1; started < threads; started ++) {
+    if(pthread_create(&tids[started], NULL, pdivideworker, &pd)) {
+      break;
+    }
+  }
+  pdivideworker(&pd);
+  for(int t = 1; t < started; t ++) {
+    pthread_join(tids[t], NULL);
+  }
+
+  if(plane) {
+    g->plane = plane;
+    rebuildplane(g);
+  }
+
+  pthread_cond_destroy(&pd.more);
+  pthread_mutex_destroy(&pd.lock);
+  free(pd.tasks);
+  free(tids);
+  return pd.failed? -1: 0;
+} /* recursivedivision() */
+
 void
 defaultmasksetting(MASKSETTING *ms)
 {
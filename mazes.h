@@ -4,8 +4,6 @@
 #ifndef _MAZES_H
 #define _MAZES_H
 
-#include <sys/queue.h>
-
 #include "grid.h"
 #include "distance.h"
 
@@ -14,7 +12,7 @@
 #define VISITED		2
 #define MASKED		17
 
-#define WALK_CONSIDER   3	/* used in wilson's notes[] */
+#define WALK_INTREE     0x7f	/* in wilson's notes[], not a direction */
 
 /* greater than any valid direction */
 #define NEEDDIR		(99+DIRECTIONS)
@@ -38,6 +36,12 @@ typedef struct hollow_config_s {
   int ctype;
 } HOLLOWCONFIG;
 
+/* for growingtree(), which active cell to grow from */
+#define GROW_NEWEST	0
+#define GROW_RANDOM	1
+#define GROW_OLDEST	2
+#define GROW_MIXED	3
+
 /* for sidewinder */
 typedef struct {
   int runlength;
@@ -45,12 +49,6 @@ typedef struct {
   int runstart_c;
 } sw_tree_status;
 
-/* for backtracker */
-typedef struct backtrack_s {
-  CELL *cell;
-  SLIST_ENTRY(backtrack_s) trail;
-} backtrack_stack_t;
-
 /* iterategrid() call backs; these can generate a "maze" by visiting
  * every cell once in any order.
  */
@@ -58,6 +56,16 @@ int btreewalker(GRID *, CELL *, void *);
 int sidewinderwalker(GRID *, CELL *, void *);
 int serpentine(GRID *, CELL *, void *);
 
+/* the same binary tree and sidewinder mazes, carved a row at a time in
+ * several threads; the maze depends on the grid's random numbers but
+ * not the number of threads
+ */
+int pbinarytree(GRID *, int /*threads*/);
+int psidewinder(GRID *, int /*threads*/);
+
+/* wall adding generator: hollow() then divide, in several threads */
+int recursivedivision(GRID *, int /*threads*/);
+
 /* by default, hollow clears all walls. Using NULL for the user config
  * pointer gets that behavior, or if a HOLLOWCONFIG with mode set to
  * HMODE_ALL is passed it, you get that behavior.
@@ -83,6 +91,26 @@ int aldbro(GRID *, MASKSETTING *);
 int wilson(GRID *, MASKSETTING *);
 int huntandkill(GRID *, MASKSETTING *);
 int backtracker(GRID *, MASKSETTING *);
+int kruskal(GRID *, MASKSETTING *);
+int growingtree(GRID *, MASKSETTING *, int /*policy*/);
+
+/* for eller(): one finished row, open[] holds a bit (1 << direction)
+ * for each passage out of each cell, the same as a connectivity plane
+ */
+typedef struct {
+  int row;
+  int rows;
+  int cols;
+  unsigned char *open;
+} ELLERROW;
+
+typedef int (*ELLERFUNC_P)(ELLERROW *, void *);
+
+/* streaming generator, needs memory for a row not a grid */
+int eller(int /*rows*/, int /*cols*/, uint64_t /*seed*/, ELLERFUNC_P, void *);
+/* eller() row call backs: param is a GRID * or a FILE * */
+int ellergridrow(ELLERROW *, void *);
+int ellerasciirow(ELLERROW *, void *);
 
 /* helper(s) */
 void defaultmasksetting(MASKSETTING *);
@@ -0,0 +1,73 @@
+/* Recursive division maze: start with no walls (hollow()) and keep
+ * splitting chambers with a wall that has a single gap in it. Big
+ * chambers are shared out between threads.
+ *
+ * Usage: recursivedivision [threads]
+ *
+ * Example maze:
+ *
+ * +---+---+---+---+---+---+---+---+---+---+
+ * |       |   |   |           |           |
+ * +   +---+   +   +   +   +   +   +   +   +
+ * |                   |   |       |   |   |
+ * +   +---+   +---+   +---+   +---+   +   +
+ * |       |   |           |   |       |   |
+ * +---+---+---+---+---+---+   +---+---+---+
+ * |       |       |       |       |       |
+ * +   +---+   +---+---+   +   +   +   +---+
+ * |       |           |   |   |           |
+ * +---+   +---+   +   +   +---+   +---+---+
+ * |   |   |       |                       |
+ * +   +   +---+   +   +---+   +---+   +   +
+ * |               |       |   |       |   |
+ * +---+   +---+---+---+   +---+---+---+---+
+ * |           |   |   |           |       |
+ * +   +   +   +   +   +   +---+   +---+   +
+ * |   |   |       |   |   |               |
+ * +---+   +---+---+   +   +   +   +   +---+
+ * |               |       |   |   |       |
+ * +---+---+---+---+---+---+---+---+---+---+
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mazes.h"
+
+
+int
+main(int argc, char**argv)
+{
+  GRID *g;
+  DMAP *dm;
+  char *board;
+  int rc, threads = 2;
+
+  if(argc > 1) { threads = atoi(argv[1]); }
+
+  g = creategrid(10, 10, 1);
+  rc = recursivedivision(g, threads);
+  if(rc) {
+    printf("Um, issue.\n");
+  }
+
+  printf("Unsolved\n");
+  board = ascii_grid(g, 0);
+  puts(board);
+  free(board);
+
+  dm = findlongestpathby(g, 1, LONGEST_DETECT);
+  if(!dm) {
+    printf("Ooops, solver broke\n");
+  }
+  namepath(dm, " A", " x", " B");
+
+  printf("\nSolved (for longest possible path)\n");
+  board = ascii_grid(g, 1);
+  puts(board);
+  free(board);
+
+  freegrid(g);
+  return 0;
+}
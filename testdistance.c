@@ -59,29 +59,321 @@ checkconnect(GRID *g, int id1, int id2, int dir)
 }
 
 int
-printpath(TRAIL *walk, int max)
+printpath(DMAP *dm, int max)
 {
   int steps = 0;
-  if(!walk) { return 1; }
+  if(!dm->pathlen) { return 1; }
   
   do {
-    printf("step %d on id(%d); ", steps++, walk->cell_id);
+    printf("step %d on id(%d); ", steps, dm->pathids[steps]);
+    steps ++;
     if(steps == max) {
       printf("\nRunaway\n");
       return 2;
     }
-  } while( (walk = walk->next) );
+  } while( steps < dm->pathlen );
 
   printf(" done\n");
   return 0;
 }
 
+/* check the TRAIL version of a path matches the array version */
+int
+checktrail(DMAP *dm)
+{
+  TRAIL *walk;
+  int steps = 0;
+
+  walk = pathtrail(dm);
+  while(walk) {
+    if(steps >= dm->pathlen) { return 1; }
+    if(walk->cell_id != dm->pathids[steps]) { return 2; }
+    if(steps && (walk->prev->cell_id != dm->pathids[steps - 1])) { return 3; }
+    steps ++;
+    walk = walk->next;
+  }
+  if(steps != dm->pathlen) { return 4; }
+  return 0;
+}
+
+/* compare the point to point solvers with a full flood fill for every
+ * pair of cells in a grid
+ */
+int
+checkpointtopoint(GRID *g)
+{
+  DMAP *full, *dm;
+  int want, got;
+
+  dm = createdistancemap(g, visitid(g, 0));
+  for(int a = 0; a < g->max; a ++) {
+    full = createdistancemap(g, visitid(g, a));
+    distanceto(full, visitid(g, 0), NONLAZYMAP);
+    for(int b = 0; b < g->max; b ++) {
+      want = full->map[b];
+      if(want == NV) { want = DISTANCE_NOPATH; }
+      for(int solver = 0; solver < 2; solver ++) {
+	resetdistancemap(dm, visitid(g, a));
+	if(solver) {
+	  got = astardistanceto(dm, visitid(g, b));
+	} else {
+	  got = bidistanceto(dm, visitid(g, b));
+	}
+	if(got != want) {
+	  printf("solver %d from %d to %d got %d, expected %d\n",
+		  solver, a, b, got, want);
+	  return 1;
+	}
+	if(got < 0) { continue; }
+	if((dm->pathlen != got + 1) || (dm->pathids[0] != a) ||
+	   (dm->pathids[got] != b)) {
+	  printf("solver %d from %d to %d bad path\n", solver, a, b);
+	  return 2;
+	}
+	for(int i = 1; i <= got; i ++) {
+	  if(isconnectedbyid(g, dm->pathids[i-1], dm->pathids[i], ANYDIR) == NC) {
+	    printf("solver %d from %d to %d path not connected\n", solver, a, b);
+	    return 3;
+	  }
+	}
+      }
+    }
+    freedistancemap(full);
+  }
+  freedistancemap(dm);
+  return 0;
+}
+
+/* compare the threaded flood fill with the serial one */
+int
+checkparallel(GRID *g, int root, int target)
+{
+  DMAP *serial, *dm;
+  int want, got;
+
+  serial = createdistancemap(g, visitid(g, root));
+  want = distanceto(serial, visitid(g, target), NONLAZYMAP);
+  for(int threads = 2; threads < 8; threads ++) {
+    dm = createdistancemap(g, visitid(g, root));
+    got = pdistanceto(dm, visitid(g, target), threads);
+    if((got != want) || (dm->farthest != serial->farthest) ||
+       (dm->farthest_id != serial->farthest_id) ||
+       (dm->target_id != serial->target_id) ||
+       memcmp(dm->map, serial->map, g->max * sizeof(int))) {
+      printf("pdistanceto with %d threads differs\n", threads);
+      return 1;
+    }
+    freedistancemap(dm);
+  }
+  freedistancemap(serial);
+  return 0;
+}
+
+/* compare the direction optimizing flood fill with the serial one */
+int
+checkdiropt(GRID *g, int root, int target)
+{
+  DMAP *serial, *dm;
+  int want, got;
+
+  for(int lazy = 0; lazy < 2; lazy ++) {
+    serial = createdistancemap(g, visitid(g, root));
+    want = distanceto(serial, visitid(g, target), lazy);
+    dm = createdistancemap(g, visitid(g, root));
+    got = diroptdistanceto(dm, visitid(g, target), lazy);
+    if((got != want) || (dm->target_id != serial->target_id)) {
+      printf("diroptdistanceto lazy %d returned %d, expected %d\n",
+		lazy, got, want);
+      return 1;
+    }
+    if(!lazy && ((dm->farthest != serial->farthest) ||
+		 (dm->map[dm->farthest_id] != dm->farthest) ||
+		 memcmp(dm->map, serial->map, g->max * sizeof(int)))) {
+      printf("diroptdistanceto map differs\n");
+      return 2;
+    }
+    freedistancemap(dm);
+    freedistancemap(serial);
+  }
+  return 0;
+}
+
+/* compare distanceto() reading the connectivity plane with reading cells */
+int
+checkplane(GRID *g, int root, int target)
+{
+  DMAP *cells, *dm;
+  int want, got;
+
+  cells = createdistancemap(g, visitid(g, root));
+  want = distanceto(cells, visitid(g, target), NONLAZYMAP);
+  enableplane(g);
+  dm = createdistancemap(g, visitid(g, root));
+  got = distanceto(dm, visitid(g, target), NONLAZYMAP);
+  disableplane(g);
+  if((got != want) || (dm->farthest_id != cells->farthest_id) ||
+     memcmp(dm->map, cells->map, g->max * sizeof(int))) {
+    printf("distanceto with connectivity plane differs\n");
+    return 1;
+  }
+  freedistancemap(dm);
+  freedistancemap(cells);
+  return 0;
+}
+
+/* threaded mazes: same maze for any thread count, and a perfect one.
+ * kind is 0 for binary tree, 1 sidewinder, 2 recursive division
+ */
+int
+checkthreadedmaze(int kind)
+{
+  GRID *one, *many;
+  TREEMAP *tm;
+  int rc = 0;
+
+  /* big enough for recursive division to share chambers out */
+  one  = creategrid(300, 250, 1);
+  many = creategrid(300, 250, 1);
+  seedgrid(one, 5);
+  seedgrid(many, 5);
+  enableplane(many);
+  if(kind == 2) {
+    recursivedivision(one, 1);
+    recursivedivision(many, 4);
+  } else if(kind == 1) {
+    psidewinder(one, 1);
+    psidewinder(many, 4);
+  } else {
+    pbinarytree(one, 1);
+    pbinarytree(many, 4);
+  }
+
+  for(int id = 0; id < one->max; id ++) {
+    for(int d = FIRSTDIR; d < FOURDIRECTIONS; d ++) {
+      if(visitid(one, id)->dir[d] != visitid(many, id)->dir[d]) {
+	printf("threaded maze differs at cell %d\n", id);
+	rc = 1;
+      }
+      if(planeopen(many, id, d) != (visitid(many, id)->dir[d] != NC)) {
+	printf("threaded maze plane out of sync at cell %d\n", id);
+	rc = 1;
+      }
+    }
+    if(rc) { break; }
+  }
+
+  tm = createtreemap(one, visitid(one, 0));
+  if(!tm || (tm->count != one->max)) {
+    printf("threaded maze is not a perfect maze\n");
+    rc = 1;
+  }
+  freetreemap(tm);
+  freegrid(one);
+  freegrid(many);
+  return rc;
+}
+
+/* eller() makes perfect mazes, and the streamed ASCII matches the grid */
+int
+checkeller(int rows, int cols)
+{
+  GRID *g;
+  TREEMAP *tm;
+  FILE *f;
+  char *board, *streamed;
+  long len;
+  int rc = 0;
+
+  g = creategrid(rows, cols, 1);
+  if(eller(rows, cols, 9, ellergridrow, g)) {
+    printf("eller() into a %d x %d grid failed\n", rows, cols);
+    return 1;
+  }
+  tm = createtreemap(g, visitid(g, 0));
+  if(!tm || (tm->count != g->max)) {
+    printf("eller() %d x %d is not a perfect maze\n", rows, cols);
+    rc = 1;
+  }
+  freetreemap(tm);
+
+  f = tmpfile();
+  if(!f || eller(rows, cols, 9, ellerasciirow, f)) {
+    printf("eller() to a file failed\n");
+    return 1;
+  }
+  len = ftell(f);
+  rewind(f);
+  streamed = (char *)calloc(1, len + 1);
+  if((long)fread(streamed, 1, len, f) != len) { rc = 1; }
+  fclose(f);
+
+  board = ascii_grid(g, 0);
+  if(strcmp(board, streamed)) {
+    printf("eller() ASCII differs from ascii_grid()\n%s\n%s\n", board,
+		streamed);
+    rc = 1;
+  }
+  free(board);
+  free(streamed);
+  freegrid(g);
+  return rc;
+}
+
+/* kruskal() or growingtree() make a perfect maze of the UNVISITED
+ * cells around a mask; policy -1 means kruskal()
+ */
+int
+checkmaskedgen(int policy)
+{
+  GRID *g;
+  TREEMAP *tm;
+  int rc = 0, masked = 0;
+
+  g = creategrid(40, 30, UNVISITED);
+  for(int id = 0; id < g->max; id ++) {
+    CELL *c = visitid(g, id);
+    /* a block in the middle */
+    if((c->row > 10) && (c->row < 20) && (c->col > 5) && (c->col < 25)) {
+      c->ctype = MASKED;
+      masked ++;
+    }
+  }
+  if((policy < 0)? kruskal(g, NULL): growingtree(g, NULL, policy)) {
+    printf("generator %d failed\n", policy);
+    return 1;
+  }
+  tm = createtreemap(g, visitid(g, 0));
+  if(!tm || (tm->count != g->max - masked)) {
+    printf("generator %d maze is not a perfect maze around the mask\n",
+		policy);
+    rc = 1;
+  }
+  for(int id = 0; id < g->max; id ++) {
+    CELL *c = visitid(g, id);
+    if((c->ctype == MASKED) && ncountbycell(g, c, EXITS, 0)) {
+      printf("generator %d connected a masked cell\n", policy);
+      rc = 1;
+      break;
+    }
+    if((c->ctype != MASKED) && (c->ctype != VISITED)) {
+      printf("generator %d left a cell unvisited\n", policy);
+      rc = 1;
+      break;
+    }
+  }
+  freetreemap(tm);
+  freegrid(g);
+  return rc;
+}
+
 int
 main(int notused, char**ignored)
 {
   GRID *g;
   CELL *c;
-  DMAP *dm;
+  DMAP *dm, *second;
+  TREEMAP *tm;
+  int *path;
   char *board;
   int distance;
   int rc;
@@ -121,11 +413,34 @@ main(int notused, char**ignored)
     printf("Find path failed %d\n", rc);
     return errorgroup;
   }
-  rc = printpath(dm->path, 101);
+  rc = printpath(dm, 101);
   if( rc != 0 ) {
     printf("printpath failed %d\n", rc);
     return errorgroup;
   }
+  rc = checktrail(dm);
+  if( rc != 0 ) {
+    printf("pathtrail mismatch %d\n", rc);
+    return errorgroup;
+  }
+
+  /* reuse the same map from the other end */
+  rc = resetdistancemap(dm, visitid(g,99));
+  if( rc != 0 ) {
+    printf("Reset distancemap failed %d\n", rc);
+    return errorgroup;
+  }
+  distance = distanceto(dm, visitid(g,9), 1);
+  if((distance != 99) || (dm->root_id != 99) || (dm->pathlen)) {
+    printf("Find distance on reset map failed %d\n", distance);
+    return errorgroup;
+  }
+  rc = findpath(dm);
+  if((rc != 0) || (dm->pathids[0] != 99)) {
+    printf("Find path on reset map failed %d\n", rc);
+    return errorgroup;
+  }
+  printf("Distance on reset map is correctly %d\n", distance);
 
   freedistancemap(dm);
   freegrid(g);
@@ -165,7 +480,7 @@ main(int notused, char**ignored)
     printf("Find path failed %d\n", rc);
     return errorgroup;
   }
-  rc = printpath(dm->path, distance+2);
+  rc = printpath(dm, distance+2);
   if( rc != 0 ) {
     printf("printpath failed %d\n", rc);
     return errorgroup;
@@ -235,7 +550,7 @@ main(int notused, char**ignored)
   }
   printf("findlongestpath found:\n");
   ascii_dmap(dm);
-  rc = printpath(dm->path, 10);
+  rc = printpath(dm, 10);
   if( rc != 0 ) {
     printf("printpath failed %d\n", rc);
     return errorgroup;
@@ -286,12 +601,12 @@ main(int notused, char**ignored)
     printf("findlongestpath microgrid failed\n");
     return errorgroup;
   }
-  rc = printpath(dm->path, 2);
+  rc = printpath(dm, 2);
   if( rc != 0 ) {
     printf("printpath failed %d\n", rc);
     return errorgroup;
   }
-  if(dm->path->cell_id != 0) {
+  if(dm->pathids[0] != 0) {
     printf("findlongestpath microgrid didn't work\n");
   }
   printf("findlongestpath microgrid worked\n");
@@ -317,12 +632,12 @@ main(int notused, char**ignored)
     printf("findlongestpath masked grid failed\n");
     return errorgroup;
   }
-  rc = printpath(dm->path, 2);
+  rc = printpath(dm, 2);
   if( rc != 0 ) {
     printf("printpath failed %d\n", rc);
     return errorgroup;
   }
-  if(dm->path->cell_id != c->id) {
+  if(dm->pathids[0] != c->id) {
     printf("findlongestpath masked grid didn't work\n");
   }
   printf("findlongestpath masked grid worked\n");
@@ -437,5 +752,158 @@ main(int notused, char**ignored)
   if(checkconnect(g, 30, 31, EAST )) { return errorgroup; }
   freegrid(g);
 
+  errorgroup ++;
+
+  /* tree maps must agree with flood fill for every pair of cells */
+  g = creategrid(8,9,1);
+  if(!g) {
+    printf("Create tree map grid failed.\n");
+    return errorgroup;
+  }
+  backtracker(g, NULL);
+  c = visitid(g, 0);
+  tm = createtreemap(g, c);
+  if(!tm || (tm->count != g->max)) {
+    printf("createtreemap failed\n");
+    return errorgroup;
+  }
+  path = (int *)malloc( g->max * sizeof(int) );
+  for(int a = 0; a < g->max; a ++) {
+    dm = createdistancemap(g, visitid(g, a));
+    distanceto(dm, visitid(g, 0), NONLAZYMAP);
+    for(int b = 0; b < g->max; b ++) {
+      distance = treedistance(tm, a, b);
+      if(distance != dm->map[b]) {
+	printf("treedistance %d to %d is %d, expected %d\n", a, b,
+		distance, dm->map[b]);
+	return errorgroup;
+      }
+      rc = treepath(tm, a, b, path);
+      if((rc != distance + 1) || (path[0] != a) || (path[rc - 1] != b)) {
+	printf("treepath %d to %d failed %d\n", a, b, rc);
+	return errorgroup;
+      }
+      for(int i = 1; i < rc; i ++) {
+	if(isconnectedbyid(g, path[i-1], path[i], ANYDIR) == NC) {
+	  printf("treepath %d to %d not connected at step %d\n", a, b, i);
+	  return errorgroup;
+	}
+      }
+    }
+    freedistancemap(dm);
+  }
+  printf("tree map distances all match\n");
+  free(path);
+
+  /* single pass longest path must match the two flood fill version */
+  dm = findlongestpath(g, VISITED);
+  second = findlongestpathby(g, VISITED, LONGEST_TREE);
+  if(!dm || !second || (dm->pathlen != second->pathlen) ||
+     (second->farthest != second->pathlen - 1)) {
+    printf("findlongestpathby tree failed\n");
+    return errorgroup;
+  }
+  for(int i = 0; i < g->max; i ++) {
+    if(second->map[i] != treedistance(tm, second->root_id, i)) {
+      printf("findlongestpathby tree map wrong at %d\n", i);
+      return errorgroup;
+    }
+  }
+  printf("findlongestpathby tree found length %d\n", second->pathlen);
+  if(checkpointtopoint(g)) { return errorgroup; }
+  printf("point to point solvers match on a tree\n");
+  if(checkparallel(g, 40, 0)) { return errorgroup; }
+  printf("threaded flood fill matches on a tree\n");
+  if(checkdiropt(g, 40, 0)) { return errorgroup; }
+  printf("direction optimizing flood fill matches on a tree\n");
+  if(checkplane(g, 40, 0)) { return errorgroup; }
+  printf("flood fill with connectivity plane matches on a tree\n");
+  freedistancemap(dm);
+  freedistancemap(second);
+  freetreemap(tm);
+
+  /* a grid with loops is not a tree */
+  hmode.ctype = 1;
+  hmode.mode = HMODE_ALL;
+  iterategrid(g, (IFUNC_P) hollow, &hmode);
+  tm = createtreemap(g, c);
+  if(tm) {
+    printf("createtreemap should have failed on loops\n");
+    return errorgroup;
+  }
+  printf("createtreemap correctly failed on loops\n");
+  if(findlongestpathby(g, VISITED, LONGEST_TREE)) {
+    printf("findlongestpathby tree should have failed on loops\n");
+    return errorgroup;
+  }
+  dm = findlongestpathby(g, VISITED, LONGEST_DETECT);
+  if(!dm || (dm->pathlen != 8 + 9 - 1)) {
+    printf("findlongestpathby detect did not fall back\n");
+    return errorgroup;
+  }
+  printf("findlongestpathby detect fell back to flood fill\n");
+  freedistancemap(dm);
+  if(checkpointtopoint(g)) { return errorgroup; }
+  printf("point to point solvers match on an open grid\n");
+  if(checkparallel(g, 40, 0)) { return errorgroup; }
+  printf("threaded flood fill matches on an open grid\n");
+  if(checkdiropt(g, 40, 0)) { return errorgroup; }
+  printf("direction optimizing flood fill matches on an open grid\n");
+
+  /* wall off the bottom right corner to have unreachable cells */
+  for(int i = 0; i < 4; i ++) {
+    disconnectbyid(g, 8 * 9 - 1 - i, NORTH, 8 * 9 - 10 - i, SYMMETRICAL);
+  }
+  disconnectbyid(g, 8 * 9 - 4, WEST, 8 * 9 - 5, SYMMETRICAL);
+  if(checkpointtopoint(g)) { return errorgroup; }
+  printf("point to point solvers match on a split grid\n");
+  if(checkparallel(g, 40, 8 * 9 - 1)) { return errorgroup; }
+  printf("threaded flood fill matches on a split grid\n");
+  if(checkdiropt(g, 40, 8 * 9 - 1)) { return errorgroup; }
+  if(checkdiropt(g, 40, 8)) { return errorgroup; }
+  printf("direction optimizing flood fill matches on a split grid\n");
+  if(checkplane(g, 40, 8 * 9 - 1)) { return errorgroup; }
+  printf("flood fill with connectivity plane matches on a split grid\n");
+  freegrid(g);
+
+  /* big enough for the threads to share out levels */
+  g = creategrid(600,600,1);
+  if(!g) {
+    printf("Create big hollow grid failed.\n");
+    return errorgroup;
+  }
+  iterategrid(g, (IFUNC_P) hollow, &hmode);
+  if(checkparallel(g, 300 * 600 + 300, 0)) { return errorgroup; }
+  printf("threaded flood fill matches on a big open grid\n");
+  if(checkdiropt(g, 300 * 600 + 300, 0)) { return errorgroup; }
+  if(checkdiropt(g, 0, 300 * 600 + 300)) { return errorgroup; }
+  printf("direction optimizing flood fill matches on a big open grid\n");
+  if(enableplane(g) || checkdiropt(g, 300 * 600 + 300, 0)) {
+    return errorgroup;
+  }
+  printf("direction optimizing flood fill matches using plane\n");
+  freegrid(g);
+
+  errorgroup ++;
+  if(checkthreadedmaze(0)) { return errorgroup; }
+  printf("threaded binary tree maze matches\n");
+  if(checkthreadedmaze(1)) { return errorgroup; }
+  printf("threaded sidewinder maze matches\n");
+  if(checkthreadedmaze(2)) { return errorgroup; }
+  printf("threaded recursive division maze matches\n");
+
+  errorgroup ++;
+  if(checkeller(30, 40) || checkeller(1, 5) || checkeller(7, 1) ||
+     checkeller(1, 1)) {
+    return errorgroup;
+  }
+  printf("eller streamed mazes are perfect and match ascii_grid()\n");
+  if(checkmaskedgen(-1)) { return errorgroup; }
+  printf("kruskal maze is perfect around a mask\n");
+  for(int policy = GROW_NEWEST; policy <= GROW_MIXED; policy ++) {
+    if(checkmaskedgen(policy)) { return errorgroup; }
+  }
+  printf("growing tree mazes are perfect around a mask\n");
+
   return 0;
 }
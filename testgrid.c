@@ -192,10 +192,24 @@ mksmallgrid(int rot)
   return g;
 }
 
+/* returns count of cells where the connectivity plane is out of sync */
+int
+planemismatches(GRID *g)
+{
+  int bad = 0;
+  for(int id = 0; id < g->max; id ++) {
+    CELL *c = visitid(g, id);
+    for(int d = FIRSTDIR; d < FOURDIRECTIONS; d ++) {
+      if(planeopen(g, id, d) != (c->dir[d] != NC)) { bad ++; break; }
+    }
+  }
+  return bad;
+}
+
 int
 main(int ignored, char**notused)
 {
-  GRID *g;
+  GRID *g, *pair;
   CELL *c1, *c2, *c3, *c4;
   int d, edges, walls, count;
   int gr, gc;
@@ -241,6 +255,16 @@ main(int ignored, char**notused)
     return(errorblock);
   }
 
+  /* nested visits on two grids must not step on each other */
+  pair = creategrid(2, 3, 1);
+  c1 = visitid(g, visitrc(pair, 1, 2)->id);
+  if(!c1 || (c1->id != 5) || (c1 != quickvisitrc(g, 0, 5)) ||
+     (visitrc(pair, 1, 2) != quickvisitid(pair, 5))) {
+    printf("nested visit failed\n");
+    return(errorblock);
+  }
+  freegrid(pair);
+
   errorblock ++;
 
   printf("Bulk naming with W/E connect on odd rows\n");
@@ -664,6 +688,88 @@ main(int ignored, char**notused)
   freegrid(little);
   freegrid(g);
 
+  errorblock ++;
+
+  g = creategrid(5,7,1);
+  if(!g || enableplane(g)) {
+    printf("connectivity plane create failed\n");
+    return errorblock;
+  }
+  for(id = 0; id < g->max - 1; id += 3) {
+    connectbyid(g, id, EAST, id + 1, SYMMETRICAL);
+    if(id + 7 < g->max) {
+      connectbyid(g, id, SOUTH, id + 7, SYMMETRICAL);
+    }
+  }
+  disconnectbyid(g, 7, NORTH, 0, SYMMETRICAL);
+  connectbyid(g, 32, NORTH, 25, NC);	/* one way */
+  if(planemismatches(g) || (planebits(g, 0) != (1 << EAST)) ||
+     !planeopen(g, 32, NORTH) || planeopen(g, 25, SOUTH)) {
+    printf("connectivity plane out of sync after connects\n");
+    return errorblock;
+  }
+  printf("connectivity plane in sync after connects\n");
+
+  rotategrid(g, CLOCKWISE);
+  if(planemismatches(g)) {
+    printf("connectivity plane out of sync after rotate\n");
+    return errorblock;
+  }
+  little = copygrid(g, 0);
+  if(!little || !little->plane || planemismatches(little)) {
+    printf("connectivity plane missing after copy\n");
+    return errorblock;
+  }
+  disconnectbyid(little, 0, SOUTH, 5, SYMMETRICAL);
+  if(planemismatches(little) || planemismatches(g)) {
+    printf("connectivity plane out of sync in copy\n");
+    return errorblock;
+  }
+  printf("connectivity plane in sync after rotate and copy\n");
+  freegrid(little);
+
+  disableplane(g);
+  connectbyid(g, 0, EAST, 1, SYMMETRICAL);
+  if(g->plane) {
+    printf("connectivity plane not disabled\n");
+    return errorblock;
+  }
+  freegrid(g);
+
+  errorblock ++;
+
+  /* per grid random numbers */
+  g = creategrid(3, 3, 1);
+  little = creategrid(3, 3, 1);
+  if(gridrandom(g) == gridrandom(little)) {
+    printf("two new grids share a random sequence\n");
+    return errorblock;
+  }
+  seedgrid(g, 7);
+  seedgrid(little, 7);
+  for(count = 0; count < 100; count ++) {
+    if(gridrandom(g) != gridrandom(little)) {
+      printf("same seed gave different random numbers\n");
+      return errorblock;
+    }
+  }
+  walls = 0;
+  for(count = 0; count < 1000; count ++) {
+    d = gridrandrange(g, 5);
+    if((d < 0) || (d >= 5)) {
+      printf("gridrandrange() out of range: %d\n", d);
+      return errorblock;
+    }
+    walls |= 1 << d;
+  }
+  if(walls != 0x1f) {
+    printf("gridrandrange() missed some values: %x\n", walls);
+    return errorblock;
+  }
+  printf("per grid random numbers okay\n");
+  freegrid(little);
+  freegrid(g);
+
   return(0);
 }
 
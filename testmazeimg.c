@@ -5,10 +5,221 @@
 /* get us some strnlen */
 #define _POSIX_C_SOURCE  200809L
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "mazeimg.h"
 #include "mazes.h"
 
 #define FILENAME_SIZE	80
+
+/* a cellkey that keeps every cell out of the tile cache */
+int
+uncachedkey(MAZEBITMAP *mb, CELL *c)
+{
+  return -1;
+}
+
+/* draws the maze again, without the tile cache or with threads if
+ * threads is non-zero, returns 1 if the result matches the bitmap in mb
+ */
+int
+sameredraw(MAZEBITMAP *mb, int threads)
+{
+  MAZEBITMAP *fresh;
+  int i, rc, same = 1;
+
+  fresh = createmazebitmap(mb->dmap);
+  if(!fresh) { return 0; }
+  if(initmazebitmap(fresh, mb->cell_h, mb->cell_w, mb->colortype,
+  			mb->colordepth, CELL_SIZE) < 0) {
+    return 0;
+  }
+  if(threads) {
+    rc = pdrawmaze(fresh, threads);
+  } else {
+    fresh->cellkey = uncachedkey;
+    rc = drawmaze(fresh);
+  }
+  if(rc != mb->dmap->grid->max) {
+    same = 0;
+  }
+  for(i = 0; same && (i < mb->img_h); i ++) {
+    if(memcmp(mb->rowsp[i], fresh->rowsp[i], mb->rowsize)) {
+      same = 0;
+    }
+  }
+  freemazebitmap(fresh);
+  free(fresh);
+  return same;
+}
+
+/* returns 1 if the two files have the same contents */
+int
+samefile(char *a, char *b)
+{
+  FILE *fa, *fb;
+  int ca, cb;
+
+  fa = fopen(a, "r");
+  fb = fopen(b, "r");
+  if(!fa || !fb) { return 0; }
+  do {
+    ca = getc(fa);
+    cb = getc(fb);
+  } while((ca == cb) && (ca != EOF));
+  fclose(fa);
+  fclose(fb);
+  return (ca == cb);
+}
+
+/* writes the maze with drawmaze() and writepng() and again with
+ * streampng(), returns 1 if the PNGs match (or PNG can't be used)
+ */
+int
+samestream(DMAP *dm, int h, int w, int ct, int cd, int cellormaze)
+{
+  MAZEBITMAP *full, *stream;
+  int rc;
+
+  full = createmazebitmap(dm);
+  stream = createmazebitmap(dm);
+  if(!full || !stream) { return 0; }
+
+  rc = initmazebitmap(full, h, w, ct, cd, cellormaze);
+  if(rc != 1) {
+    /* not PNG compatible, nothing to compare */
+    return (rc == 0);
+  }
+  if(setupmazebitmap(stream, h, w, ct, cd, cellormaze) != 1) {
+    return 0;
+  }
+  if(stream->rowsp) { return 0; }
+
+  drawmaze(full);
+  writepng(full, "tmp-full.png");
+  rc = streampng(stream, "tmp-stream.png");
+  freemazebitmap(full);
+  free(full);
+  free(stream);
+
+  if(rc != dm->grid->max) { return 0; }
+  return samefile("tmp-full.png", "tmp-stream.png");
+}
+
+/* reads a PNG back and returns 1 if the pixels match the bitmap in mb */
+int
+samepixels(MAZEBITMAP *mb, char *fname)
+{
+  png_structp png_ptr;
+  png_infop info_ptr;
+  png_byte *row = NULL;
+  int i, same = 1;
+  FILE *fp;
+
+  fp = fopen(fname, "r");
+  if(!fp) { return 0; }
+  png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  info_ptr = png_create_info_struct(png_ptr);
+  if (setjmp(png_jmpbuf(png_ptr))) {
+    fclose(fp);
+    return 0;
+  }
+  png_init_io(png_ptr, fp);
+  png_read_info(png_ptr, info_ptr);
+  if((png_get_image_width(png_ptr, info_ptr)  != mb->img_w) ||
+     (png_get_image_height(png_ptr, info_ptr) != mb->img_h) ||
+     (png_get_bit_depth(png_ptr, info_ptr)    != mb->colordepth) ||
+     (png_get_color_type(png_ptr, info_ptr)   != mb->colortype)) {
+    same = 0;
+  } else {
+    row = (png_byte *)malloc( png_get_rowbytes(png_ptr, info_ptr) );
+    for(i = 0; i < mb->img_h; i ++) {
+      png_read_row(png_ptr, row, NULL);
+      if(memcmp(row, mb->rowsp[i], png_get_rowbytes(png_ptr, info_ptr))) {
+        same = 0;
+      }
+    }
+    png_read_end(png_ptr, NULL);
+    free(row);
+  }
+  png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+  fclose(fp);
+  return same;
+}
+
+/* draws a maze big enough to need several pieces and writes it with
+ * pwritepng() using each filter, returns 1 if it all reads back right
+ * and a bad zlevel is refused
+ */
+int
+samepwrite(DMAP *dm, int ct, int cd)
+{
+  MAZEBITMAP *mb;
+  int filter, same = 1;
+
+  mb = createmazebitmap(dm);
+  if(!mb) { return 0; }
+  if(initmazebitmap(mb, 900, 1000, ct, cd, MAZE_SIZE) != 1) {
+    /* not PNG compatible, nothing to compare */
+    return 1;
+  }
+  drawmaze(mb);
+  mb->zlevel = ZLEVEL_MAX + 1;
+  if((pwritepng(mb, "tmp-pwrite.png", 3) != ZLEVEL_ERROR) ||
+     (writepng(mb, "tmp-pwrite.png") != ZLEVEL_ERROR)) {
+    same = 0;
+  }
+  for(filter = FILTER_DEFAULT; same && (filter <= FILTER_ADAPTIVE);
+  						filter ++) {
+    mb->filter = filter;
+    mb->zlevel = (filter == FILTER_NONE)? 0: ZLEVEL_DEFAULT;
+    if(pwritepng(mb, "tmp-pwrite.png", 3) ||
+       !samepixels(mb, "tmp-pwrite.png")) {
+      same = 0;
+    }
+  }
+  freemazebitmap(mb);
+  free(mb);
+  return same;
+}
+
+/* setpalette() shares entries for repeated colors and refuses to go
+ * past what the depth can index, returns 1 if that all works
+ */
+int
+checksetpalette(void)
+{
+  MAZEBITMAP mb = { .colortype = COLOR_PALETTE, .colordepth = 2 };
+  COLORDATA cd = {
+      .wall = {   0,   0,   0, 0 },
+      .edge = {   0,   0,   0, 0 },
+      .fg   = {   0, 210,   0, 0 },
+      .bg   = { 250, 250, 250, 0 },
+  };
+
+  if(setpalette(&mb, &cd) != 3) { return 0; }
+  if((cd.wall[0] != 0) || (cd.edge[0] != 0) || (cd.fg[0] != 1) ||
+     (cd.bg[0] != 2) || (cd.uc4[0] != 0) || (cd.fg[1] != 0)) {
+    return 0;
+  }
+  if((mb.palette[1].green != 210) || (mb.palette[2].blue != 250)) {
+    return 0;
+  }
+
+  cd = (COLORDATA) {
+      .fg   = {   0, 210,   0, 0 },
+      .bg   = { 250, 250, 250, 0 },
+      .uc1  = { 240, 240,   0, 0 },
+      .uc2  = { 240,   0, 240, 0 },
+  };
+  if(setpalette(&mb, &cd) != -1) { return 0; }
+
+  mb.colortype = COLOR_RGB;
+  if(setpalette(&mb, &cd) != -1) { return 0; }
+  return 1;
+}
+
 int
 main()
 {
@@ -21,7 +232,15 @@ main()
   int usecolor;
   int usedepth;
 
-  for(times = 0; times < 11; times ++) {
+  if(checksetpalette()) {
+    printf("setpalette works\n");
+  } else {
+    printf("setpalette failed\n");
+    return errorgroup;
+  }
+  errorgroup ++;
+
+  for(times = 0; times < 15; times ++) {
     switch (times) {
        case 0: usecolor = COLOR_G;
 	       usedepth = 1;
@@ -67,6 +286,22 @@ main()
 	       usedepth = 16;
 	       snprintf(fname, FILENAME_SIZE, "tmp-rgbalpha-16.png");
 	       break;
+       case 11: usecolor = COLOR_PALETTE;
+	       usedepth = 1;
+	       snprintf(fname, FILENAME_SIZE, "tmp-palette-1.png");
+	       break;
+       case 12: usecolor = COLOR_PALETTE;
+	       usedepth = 2;
+	       snprintf(fname, FILENAME_SIZE, "tmp-palette-2.png");
+	       break;
+       case 13: usecolor = COLOR_PALETTE;
+	       usedepth = 4;
+	       snprintf(fname, FILENAME_SIZE, "tmp-palette-4.png");
+	       break;
+       case 14: usecolor = COLOR_PALETTE;
+	       usedepth = 8;
+	       snprintf(fname, FILENAME_SIZE, "tmp-palette-8.png");
+	       break;
     }
     
     g = creategrid(16,16,1);
@@ -119,11 +354,41 @@ main()
       return errorgroup;
     }
 
+    if(sameredraw(mb, 0)) {
+      printf("tile cache matches uncached draw\n");
+    } else {
+      printf("tile cache differs from uncached draw\n");
+      return errorgroup;
+    }
+
+    if(sameredraw(mb, 1) && sameredraw(mb, 3)) {
+      printf("pdrawmaze matches drawmaze\n");
+    } else {
+      printf("pdrawmaze differs from drawmaze\n");
+      return errorgroup;
+    }
+
+    /* one size in whole cells, one with leftover rows and columns */
+    if(samestream(dm, 15, 15, usecolor, usedepth, CELL_SIZE) &&
+       samestream(dm, 250, 247, usecolor, usedepth, MAZE_SIZE)) {
+      printf("streampng matches writepng\n");
+    } else {
+      printf("streampng differs from writepng\n");
+      return errorgroup;
+    }
+
     rc = writepng(mb, fname);
     if(!rc) {
       printf("Wrote %s\n",fname);
     }
 
+    if(samepixels(mb, fname) && samepwrite(dm, usecolor, usedepth)) {
+      printf("pwritepng matches writepng\n");
+    } else {
+      printf("pwritepng differs from writepng\n");
+      return errorgroup;
+    }
+
     /* suffix tweaking: .png to .pnm */
     int j = strnlen(fname, FILENAME_SIZE);
     j -= 1;
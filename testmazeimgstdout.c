@@ -235,7 +235,7 @@ main()
     return errorgroup;
   }
 
-  srandom(34);		/* for a reproducible random number sequence */
+  seedgrid(g, 34);	/* for a reproducible random number sequence */
   rc = backtracker(g, 0);
   if(rc) {
     fprintf(stderr, "Failed to draw a backtrack maze\n");